@@ -0,0 +1,54 @@
+/* Match text against a grammar read at runtime (see src/matcher.h) and
+ * print the extent of each match and its captures.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "matcher.h"
+
+static char *text=
+  "pairs	= pair ( ',' _ pair )* !.\n"
+  "pair	= k:key _ '=' _ v:value _\n"
+  "key	= < [a-z]+ >\n"
+  "value	= number | word\n"
+  "number	= < [0-9]+ >\n"
+  "word	= [a-z]+\n"
+  "_	= ' '*\n";
+
+static void run(Grammar *grammar, char *rule, char *input)
+{
+    Match match;
+    int   i;
+
+    printf("%s '%s':", rule ? rule : "(start)", input);
+    if (!Grammar_match(grammar, rule, input, strlen(input), &match))
+    {
+        printf(" no match\n");
+        return;
+    }
+    printf(" %d-%d\n", match.begin, match.end);
+    for (i= 0;  i < match.count;  ++i)
+    {
+        Capture *c= match.captures + i;
+        printf("  %s %d-%d '%.*s'\n", c->name, c->begin, c->end, c->end - c->begin, input + c->begin);
+    }
+    Match_release(&match);
+}
+
+int main()
+{
+    Grammar *grammar= Grammar_parse(text, strlen(text), GrammarLeg);
+
+    if (!grammar)
+    {
+        fprintf(stderr, "cannot read grammar\n");
+        return 1;
+    }
+    run(grammar, 0, "width = 80, colour = red");
+    run(grammar, 0, "width = 80,");
+    run(grammar, "pair", "depth=7 and more");
+    run(grammar, "number", "123abc");
+    run(grammar, "key", "42");
+    Grammar_release(grammar);
+    return 0;
+}
@@ -0,0 +1,116 @@
+/* Compile a grammar read at runtime into native code (see
+ * src/matcher.h) and check that it matches exactly as the interpreter
+ * does: when waiting for the compiler, while the compiler is still
+ * running, and when the code is loaded again from the directory.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <dirent.h>
+#include <utime.h>
+#include <sys/stat.h>
+#include "matcher.h"
+
+static char *text=
+  "pairs	= pair ( ',' _ pair )* !.\n"
+  "pair	= k:key _ '=' _ v:value _\n"
+  "key	= < [a-z]+ >\n"
+  "value	= number | word\n"
+  "number	= < [0-9]+ >\n"
+  "word	= [a-z]+\n"
+  "_	= ' '*\n";
+
+static char *inputs[]= { "width = 80, colour = red", "width = 80,", "a=1,b=c,d=22", 0 };
+
+/* Answer the matches of every input, one line each. */
+static void matches(Grammar *grammar, char *out)
+{
+    Match match;
+    int   i, j;
+
+    *out= '\0';
+    for (i= 0;  inputs[i];  ++i)
+    {
+        if (!Grammar_match(grammar, 0, inputs[i], strlen(inputs[i]), &match))
+        {
+            strcat(out, "no match\n");
+            continue;
+        }
+        sprintf(out + strlen(out), "%d-%d", match.begin, match.end);
+        for (j= 0;  j < match.count;  ++j)
+            sprintf(out + strlen(out), " %s:%d-%d", match.captures[j].name, match.captures[j].begin, match.captures[j].end);
+        strcat(out, "\n");
+        Match_release(&match);
+    }
+}
+
+enum { Count, Age, Old };
+
+/* Answer the number of files in directory whose names end with suffix,
+ * making them old (Age) or counting only those that are old (Old).
+ */
+static int files(char *directory, char *suffix, int how)
+{
+    char	   path[1024];
+    struct utimbuf old= { 0, 0 };
+    struct stat    info;
+    struct dirent *entry;
+    DIR		  *dir= opendir(directory);
+    int		   count= 0;
+
+    while ((entry= readdir(dir)))
+    {
+        int length= strlen(entry->d_name);
+        if (length < strlen(suffix) || strcmp(entry->d_name + length - strlen(suffix), suffix)) continue;
+        sprintf(path, "%s/%s", directory, entry->d_name);
+        if (Age == how) utime(path, &old);
+        if (Old != how || (!stat(path, &info) && !info.st_mtime)) ++count;
+    }
+    closedir(dir);
+    return count;
+}
+
+static void check(char *what, char *expected, char *actual)
+{
+    printf("%s: %s\n", what, strcmp(expected, actual) ? "differs" : "same");
+    if (strcmp(expected, actual))
+        printf("%s", actual);
+}
+
+int main(int argc, char **argv)
+{
+    static char interpreted[4096], compiled[4096], other[4096];
+    char       *directory= argc > 1 ? argv[1] : ".";
+    Grammar    *grammar= Grammar_parse(text, strlen(text), GrammarLeg);
+
+    matches(grammar, interpreted);
+    printf("%s", interpreted);
+
+    Grammar_compile(grammar, directory, 1);
+    matches(grammar, compiled);
+    check("wait=1", interpreted, compiled);
+    Grammar_release(grammar);
+    printf("objects %d\n", files(directory, ".so", Age));
+
+    /* A different grammar, with the same matches, not compiled yet. */
+    strcpy(other, text);
+    strcpy(strstr(other, "' '*"), "[ ]*\n");
+    grammar= Grammar_parse(other, strlen(other), GrammarLeg);
+    Grammar_compile(grammar, directory, 0);
+    matches(grammar, compiled);
+    check("wait=0", interpreted, compiled);
+    Grammar_release(grammar);
+    printf("objects %d\n", files(directory, ".so", Count));
+
+    /* The first grammar again, loaded from the directory without
+     * compiling: no source is written and the object stays old.
+     */
+    grammar= Grammar_parse(text, strlen(text), GrammarLeg);
+    Grammar_compile(grammar, directory, 0);
+    printf("sources %d\n", files(directory, ".c", Count));
+    matches(grammar, compiled);
+    check("cached", interpreted, compiled);
+    Grammar_release(grammar);
+    printf("objects %d, old %d\n", files(directory, ".so", Count), files(directory, ".so", Old));
+    return 0;
+}
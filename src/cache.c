@@ -0,0 +1,349 @@
+/* Copyright (c) 2007, 2012 by Ian Piumarta
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the 'Software'),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, provided that the above copyright notice(s) and this
+ * permission notice appear in all copies of the Software.  Acknowledgement
+ * of the use of this Software in supporting documentation would be
+ * appreciated but is not required.
+ *
+ * THE SOFTWARE IS PROVIDED 'AS IS'.  USE ENTIRELY AT YOUR OWN RISK.
+ */
+
+/* Incremental generation.  Each rule is keyed by a hash of its own
+ * expression and of the expressions of every rule it can reach.  The
+ * code generated for a rule is stored under that key in the cache file
+ * named by the -c option and reused verbatim by later runs for which
+ * the key is unchanged.  In cache mode output files are written to a
+ * temporary stream first and only replace the named file if their
+ * contents differ, so that unchanged outputs keep their timestamps.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "version.h"
+#include "tree.h"
+
+typedef unsigned long long Key;
+
+typedef struct Entry Entry;
+
+struct Entry {
+    Key    key;
+    char  *text;
+    Entry *next;
+};
+
+char *cacheName= 0;
+
+#define TABLE_SIZE	1024
+
+static Entry *oldEntries[TABLE_SIZE];	/* read from the cache file */
+static Entry *newEntries[TABLE_SIZE];	/* written back to the cache file */
+static Key   *ruleKeys= 0;		/* indexed by rule id */
+
+#define FNV_OFFSET	0xcbf29ce484222325ULL
+#define FNV_PRIME	0x100000001b3ULL
+
+static Key hashBytes(Key h, const void *data, int length)
+{
+    const unsigned char *p= data;
+    while (length--)
+    {
+        h ^= *p++;
+        h *= FNV_PRIME;
+    }
+    return h;
+}
+
+static Key hashInt(Key h, int n)	{ return hashBytes(h, &n, sizeof(n)); }
+static Key hashString(Key h, char *s)	{ return s ? hashBytes(h, s, strlen(s) + 1) : hashInt(h, -1); }
+
+static Key Node_hash(Key h, Node *node)
+{
+    for (;  node;  node= node->any.next)
+    {
+        h= hashInt(h, node->type);
+        switch (node->type)
+        {
+            case Name:
+                h= hashString(h, node->name.rule->rule.name);
+                h= hashString(h, node->name.variable ? node->name.variable->variable.name : 0);
+                break;
+            case Dot:							break;
+            case Character:	h= hashString(h, node->string.value);		break;
+            case String:
+                h= hashString(h, node->string.value);
+                h= hashInt(h, node->string.flags);
+                break;
+            case Class:		h= hashString(h, (char *)node->cclass.value);	break;
+            case Action:
+                h= hashString(h, node->action.text);
+                h= hashInt(h, node->action.flags);
+                break;
+            case Predicate:	h= hashString(h, node->predicate.text);		break;
+            case Error:
+                h= hashString(h, node->error.text);
+                h= Node_hash(h, node->error.element);
+                break;
+            case Alternate:	h= Node_hash(h, node->alternate.first);		break;
+            case Sequence:	h= Node_hash(h, node->sequence.first);		break;
+            case PeekFor:
+            case PeekNot:
+            case Query:
+            case Star:
+            case Plus:		h= Node_hash(h, node->query.element);		break;
+            default:
+                fprintf(stderr, "\nNode_hash: illegal node type %d\n", node->type);
+                exit(1);
+        }
+        h= hashInt(h, -2);	/* end of children */
+    }
+    return h;
+}
+
+static Key Rule_ownKey(Node *rule)
+{
+    Key   h= FNV_OFFSET;
+    Node *v;
+    h= hashString(h, rule->rule.name);
+    for (v= rule->rule.variables;  v;  v= v->variable.next)
+        h= hashString(h, v->variable.name);
+    h= hashInt(h, rule == start);
+    h= hashInt(h, rule->rule.id);	/* baked into tree nodes and memo slots */
+    return Node_hash(h, rule->rule.expression);
+}
+
+static void Node_reach(Node *node, char *reached)
+{
+    for (;  node;  node= node->any.next)
+        switch (node->type)
+        {
+            case Name:
+                {
+                    Node *rule= node->name.rule;
+                    if (!reached[rule->rule.id])
+                    {
+                        reached[rule->rule.id]= 1;
+                        Node_reach(rule->rule.expression, reached);
+                    }
+                }
+                break;
+            case Error:		Node_reach(node->error.element, reached);	break;
+            case Alternate:	Node_reach(node->alternate.first, reached);	break;
+            case Sequence:	Node_reach(node->sequence.first, reached);	break;
+            case PeekFor:
+            case PeekNot:
+            case Query:
+            case Star:
+            case Plus:		Node_reach(node->query.element, reached);	break;
+            default:							break;
+        }
+}
+
+static Entry *Entry_find(Entry **table, Key key)
+{
+    Entry *entry;
+    for (entry= table[key % TABLE_SIZE];  entry;  entry= entry->next)
+        if (entry->key == key)
+            return entry;
+    return 0;
+}
+
+static void Entry_add(Entry **table, Key key, char *text)
+{
+    Entry *entry= malloc(sizeof(Entry));
+    entry->key= key;
+    entry->text= text;
+    entry->next= table[key % TABLE_SIZE];
+    table[key % TABLE_SIZE]= entry;
+}
+
+static void Cache_read(void)
+{
+    FILE *in= fopen(cacheName, "rb");
+    char  magic[32];
+    Key   key;
+    int   length;
+
+    if (!in) return;
+    if (1 != fscanf(in, "%31s\n", magic) || strcmp(magic, "peg-cache-1"))
+    {
+        fprintf(stderr, "%s: not a peg cache file; ignoring it\n", cacheName);
+        fclose(in);
+        return;
+    }
+    while (2 == fscanf(in, "%llx %d", &key, &length) && length >= 0 && '\n' == fgetc(in))
+    {
+        char *text= malloc(length + 1);
+        if (length != fread(text, 1, length, in))
+        {
+            free(text);
+            break;
+        }
+        text[length]= '\0';
+        Entry_add(oldEntries, key, text);
+        fgetc(in);
+    }
+    fclose(in);
+}
+
+/* Compute the keys of all rules.  The salt distinguishes output
+ * generated by different back ends and options for the same grammar.
+ */
+void Cache_begin(char *salt)
+{
+    Node  *n, **byId;
+    Key   *own, base;
+    char  *reached;
+    int    i;
+
+    if (!cacheName) return;
+    byId= calloc(ruleCount + 1, sizeof(Node *));
+    own= calloc(ruleCount + 1, sizeof(Key));
+    reached= malloc(ruleCount + 1);
+    base= hashString(hashInt(hashInt(hashInt(FNV_OFFSET, PEG_MAJOR), PEG_MINOR), PEG_LEVEL), salt);
+    ruleKeys= calloc(ruleCount + 1, sizeof(Key));
+    for (n= rules;  n;  n= n->rule.next)
+    {
+        byId[n->rule.id]= n;
+        own[n->rule.id]= Rule_ownKey(n);
+    }
+    for (n= rules;  n;  n= n->rule.next)
+    {
+        Key h= hashBytes(base, &own[n->rule.id], sizeof(Key));
+        memset(reached, 0, ruleCount + 1);
+        reached[n->rule.id]= 1;
+        Node_reach(n->rule.expression, reached);
+        for (i= 1;  i <= ruleCount;  ++i)
+            if (reached[i] && i != n->rule.id && byId[i])
+                h= hashBytes(h, &own[i], sizeof(Key));
+        ruleKeys[n->rule.id]= h;
+    }
+    free(byId);
+    free(own);
+    free(reached);
+    Cache_read();
+}
+
+/* Answer the text previously generated for rule, or 0.  Safe to call
+ * concurrently once Cache_begin() has returned.
+ */
+char *Cache_find(Node *rule)
+{
+    Entry *entry;
+    if (!cacheName) return 0;
+    entry= Entry_find(oldEntries, ruleKeys[rule->rule.id]);
+    return entry ? entry->text : 0;
+}
+
+void Cache_add(Node *rule, char *text)
+{
+    if (!cacheName || Entry_find(newEntries, ruleKeys[rule->rule.id])) return;
+    Entry_add(newEntries, ruleKeys[rule->rule.id], strdup(text));
+}
+
+/* Replace the cache file with the entries added during this run,
+ * discarding those for rules that no longer exist.
+ */
+void Cache_end(void)
+{
+    Buffer buf;
+    Entry *entry;
+    FILE  *out;
+    int    i;
+
+    if (!cacheName) return;
+    Buffer_init(&buf);
+    Buffer_printf(&buf, "peg-cache-1\n");
+    for (i= 0;  i < TABLE_SIZE;  ++i)
+        for (entry= newEntries[i];  entry;  entry= entry->next)
+        {
+            Buffer_printf(&buf, "%llx %d\n", entry->key, (int)strlen(entry->text));
+            Buffer_printf(&buf, "%s\n", entry->text);
+        }
+    out= openOutput(cacheName);
+    fwrite(buf.text, 1, buf.length, out);
+    closeOutput(out);
+    Buffer_release(&buf);
+}
+
+
+typedef struct Output Output;
+
+struct Output {
+    char   *name;
+    FILE   *stream;
+    Output *next;
+};
+
+static Output *outputs= 0;
+
+FILE *openOutput(char *name)
+{
+    Output *o;
+    FILE   *stream= cacheName ? tmpfile() : fopen(name, "w");
+    if (!stream)
+    {
+        perror(name);
+        exit(1);
+    }
+    o= malloc(sizeof(Output));
+    o->name= name;
+    o->stream= stream;
+    o->next= outputs;
+    outputs= o;
+    return stream;
+}
+
+static int sameContents(FILE *stream, char *name)
+{
+    FILE *old= fopen(name, "rb");
+    int   a, b;
+    if (!old) return 0;
+    rewind(stream);
+    do {
+        a= getc(stream);
+        b= getc(old);
+    } while (a == b && EOF != a);
+    fclose(old);
+    return a == b;
+}
+
+void closeOutput(FILE *stream)
+{
+    Output **op, *o;
+    for (op= &outputs;  (o= *op);  op= &o->next)
+        if (o->stream == stream)
+            break;
+    assert(o);
+    *op= o->next;
+    if (cacheName && !sameContents(stream, o->name))
+    {
+        FILE *out= fopen(o->name, "wb");
+        char  chunk[8192];
+        int   n;
+        if (!out)
+        {
+            perror(o->name);
+            exit(1);
+        }
+        rewind(stream);
+        while ((n= fread(chunk, 1, sizeof(chunk), stream)) > 0)
+            fwrite(chunk, 1, n, out);
+        if (fclose(out))
+        {
+            perror(o->name);
+            exit(1);
+        }
+    }
+    fclose(stream);
+    free(o);
+}
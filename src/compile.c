@@ -19,6 +19,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
 #include <assert.h>
 
 #ifdef WIN32
@@ -29,10 +30,18 @@
 #include "version.h"
 #include "tree.h"
 
-static int yyl(void)
+typedef struct Code Code;
+
+struct Code {
+    Buffer buf;		/* generated text of one rule */
+    int    label;	/* last label allocated within that rule */
+    int    scanning;	/* the position is the local yyp, not yy->__pos */
+    int    hint;	/* tests are unlikely to fail (see Node_compile_c_elements) */
+};
+
+static int yyl(Code *code)
 {
-    static int prev= 0;
-    return ++prev;
+    return ++code->label;
 }
 
 static void charClassSet  (unsigned char bits[], int c)	{ bits[c >> 3] |=  (1 << (c & 7)); }
@@ -42,7 +51,8 @@ typedef void (*setter)(unsigned char bits[], int c);
 
 static inline int oigit(int c)	{ return '0' <= c && c <= '7'; }
 
-static int cnext(unsigned char **ccp)
+/* Answer the next character in a literal or class, decoding escapes. */
+int Char_next(unsigned char **ccp)
 {
     unsigned char *cclass= *ccp;
     int c= *cclass++;
@@ -75,13 +85,10 @@ static int cnext(unsigned char **ccp)
     return c;
 }
 
-static char *makeCharClass(unsigned char *cclass)
+void Class_bits(unsigned char bits[32], unsigned char *cclass)
 {
-    unsigned char	 bits[32];
     setter	 set;
     int		 c, prev= -1;
-    static char	 string[256];
-    char		*ptr;
 
     if ('^' == *cclass)
     {
@@ -100,283 +107,1329 @@ static char *makeCharClass(unsigned char *cclass)
         if ('-' == *cclass && cclass[1] && prev >= 0)
         {
             ++cclass;
-            for (c= cnext(&cclass);  prev <= c;  ++prev)
+            for (c= Char_next(&cclass);  prev <= c;  ++prev)
                 set(bits, prev);
             prev= -1;
         }
         else
         {
-            c= cnext(&cclass);
+            c= Char_next(&cclass);
             set(bits, prev= c);
         }
     }
 
-    ptr= string;
+}
+
+void Class_compile_c(Buffer *buf, unsigned char *cclass)
+{
+    unsigned char bits[32];
+    int		  c;
+
+    Class_bits(bits, cclass);
     for (c= 0;  c < 32;  ++c)
-        ptr += sprintf(ptr, "\\%03o", bits[c]);
+        Buffer_printf(buf, "\\%03o", bits[c]);
+}
+
+/* Write the literal text with its ASCII letters in lower case to lower,
+ * as the contents of a C string, and to mask a string that has 0x20 at
+ * each letter and 0 elsewhere, setting length to the number of bytes.
+ * Answer how many letters there are.
+ */
+int String_fold(Buffer *lower, Buffer *mask, int *length, char *text)
+{
+    unsigned char *p= (unsigned char *)text;
+    int		   c, letters= 0;
 
-    return string;
+    *length= 0;
+    while (*p)
+    {
+        int letter= (c= Char_next(&p)) < 128 && isalpha(c);
+        if (letter)
+        {
+            c= tolower(c);
+            ++letters;
+        }
+        if (isprint(c) && c < 128 && '"' != c && '\\' != c && '?' != c)
+            Buffer_printf(lower, "%c", c);
+        else
+            Buffer_printf(lower, "\\%03o", c);
+        Buffer_printf(mask, "\\%03o", letter ? 0x20 : 0);
+        ++*length;
+    }
+    return letters;
 }
 
-static void begin(void)		{ fprintf(output, "\n  {"); }
-static void end(void)		{ fprintf(output, "\n  }"); }
-static void label(int n)	{ fprintf(output, "\n  l%d:;\t", n); }
-static void jump(int n)		{ fprintf(output, "  goto l%d;", n); }
-static void save(int n)		{ fprintf(output, "  int yypos%d= yy->__pos, yythunkpos%d= yy->__thunkpos, yybegin%d= yy->__begin, yyend%d= yy->__end;", n, n, n, n); }
-static void restore(int n)	{ fprintf(output,     "  yy->__pos= yypos%d; yy->__thunkpos= yythunkpos%d; yy->__begin = yybegin%d, yy->__end = yyend%d;", n, n, n, n); }
+static void begin(Code *code)		{ Buffer_printf(&code->buf, "\n  {"); }
+static void end(Code *code)		{ Buffer_printf(&code->buf, "\n  }"); }
+static void label(Code *code, int n)	{ Buffer_printf(&code->buf, "\n  l%d:;\t", n); }
+static void jump(Code *code, int n)	{ Buffer_printf(&code->buf, "  goto l%d;", n); }
+
+/* Wrap the condition of a test that fails in YY_UNLIKELY() for hint > 0
+ * and in YY_LIKELY() for hint < 0.
+ */
+static char *hintOn(int hint)	{ return hint > 0 ? "YY_UNLIKELY(" : (hint < 0 ? "YY_LIKELY(" : ""); }
+static char *hintOff(int hint)	{ return hint ? ")" : ""; }
+
+static int	      profileCount= 0;	/* rules named in the profile */
+static unsigned long *profileCalls= 0;	/* indexed by rule id */
+static unsigned long *profileFails= 0;
+static unsigned long  profileMean= 0;	/* calls to a rule that was called */
+static unsigned long **profileChosen= 0;	/* successes of each alternative in a rule */
+static int	      *profileChoices= 0;	/* the number of those */
+static unsigned long long profileHash= 0;
 
-static void Node_compile_c_ko(Node *node, int ko)
+static int *choiceOf= 0;	/* the number of an alternative within its rule, by node id */
+static int  choiceOfSize= 0;
+static int *choiceCount= 0;	/* the number of alternatives in a rule, by rule id */
+
+/* Read one line of any length from in into line, answering whether
+ * there was one.
+ */
+static int readLine(Buffer *line, FILE *in)
 {
-    assert(node);
-    switch (node->type)
-    {
-        case Rule:
-            fprintf(stderr, "\ninternal error #1 (%s)\n", node->rule.name);
-            exit(1);
-            break;
+    char chunk[256];
 
-        case Dot:
-            fprintf(output, "  if (!yymatchDot(yy)) goto l%d;", ko);
-            break;
+    line->length= 0;
+    line->text[0]= '\0';
+    while (fgets(chunk, sizeof(chunk), in))
+    {
+        Buffer_append(line, chunk, strlen(chunk));
+        if ('\n' == line->text[line->length - 1]) break;
+    }
+    return line->length > 0;
+}
 
-        case Name:
-            fprintf(output, "  if (!yy_%s(yy)) goto l%d;", node->name.rule->rule.name, ko);
-            if (node->name.variable)
-                fprintf(output, "  yyDo(yy, yySet, %d, 0);", node->name.variable->variable.offset);
-            break;
+/* Read the counts written by yyprofile() in a parser compiled with
+ * YY_PROFILE defined: the name of a rule, the number of calls and of
+ * failures, and how often each of its alternatives succeeded.  Counts
+ * for the same rule are added, so profiles of several runs can simply
+ * be concatenated.  profileHash identifies the counts, since the code
+ * generated for a rule depends on them.
+ */
+static void Rule_readProfile(void)
+{
+    unsigned long long hash= 14695981039346656037ULL;
+    unsigned long      calls, fails, total= 0;
+    char	       name[1024], *p, *q;
+    Buffer	       line;
+    FILE	      *in;
+    Node	      *n;
+    int		       i, length, called= 0;
 
-        case Character:
-        case String:
-            {
-                int len= strlen(node->string.value);
-                if (1 == len)
+    if (!(in= fopen(profileName, "r")))
+    {
+        perror(profileName);
+        exit(1);
+    }
+    profileCalls= calloc(ruleCount + 1, sizeof(unsigned long));
+    profileFails= calloc(ruleCount + 1, sizeof(unsigned long));
+    profileChosen= calloc(ruleCount + 1, sizeof(unsigned long *));
+    profileChoices= calloc(ruleCount + 1, sizeof(int));
+    Buffer_init(&line);
+    while (readLine(&line, in))
+        if (3 == sscanf(line.text, "%1023s %lu %lu%n", name, &calls, &fails, &length))
+            for (n= rules;  n;  n= n->rule.next)
+                if (!strcmp(n->rule.name, name))
                 {
-                    if ('\'' == node->string.value[0])
-                        fprintf(output, "  if (!yymatchChar(yy, '\\'')) goto l%d;", ko);
-                    else
-                        fprintf(output, "  if (!yymatchChar(yy, '%s')) goto l%d;", node->string.value, ko);
+                    profileCalls[n->rule.id] += calls;
+                    profileFails[n->rule.id] += fails;
+                    for (i= 0, p= line.text + length;  calls= strtoul(p, &q, 10), q != p;  ++i, p= q)
+                    {
+                        if (i == profileChoices[n->rule.id])
+                        {
+                            profileChosen[n->rule.id]= realloc(profileChosen[n->rule.id], sizeof(unsigned long) * (i + 1));
+                            profileChosen[n->rule.id][profileChoices[n->rule.id]++]= 0;
+                        }
+                        profileChosen[n->rule.id][i] += calls;
+                    }
+                    ++profileCount;
+                    break;
                 }
-                else
-                    if (2 == len && '\\' == node->string.value[0])
-                        fprintf(output, "  if (!yymatchChar(yy, '%s')) goto l%d;", node->string.value, ko);
-                    else
-                        fprintf(output, "  if (!yymatchString(yy, \"%s\")) goto l%d;", node->string.value, ko);
-            }
-            break;
+    Buffer_release(&line);
+    fclose(in);
+    if (!profileCount)
+        fprintf(stderr, "%s: no rules of this grammar in profile; ignoring it\n", profileName);
+    for (n= rules;  n;  n= n->rule.next)
+    {
+        for (i= 0;  n->rule.name[i];  ++i)
+            hash= (hash ^ (unsigned char)n->rule.name[i]) * 1099511628211ULL;
+        hash= (hash ^ profileCalls[n->rule.id]) * 1099511628211ULL;
+        hash= (hash ^ profileFails[n->rule.id]) * 1099511628211ULL;
+        for (i= 0;  i < profileChoices[n->rule.id];  ++i)
+            hash= (hash ^ profileChosen[n->rule.id][i]) * 1099511628211ULL;
+        if (profileCalls[n->rule.id])
+        {
+            total += profileCalls[n->rule.id];
+            ++called;
+        }
+    }
+    profileMean= called ? total / called : 0;
+    profileHash= hash;
+}
 
-        case Class:
-            fprintf(output, "  if (!yymatchClass(yy, (unsigned char *)\"%s\")) goto l%d;", makeCharClass(node->cclass.value), ko);
-            break;
+static void Profile_release(void)
+{
+    int i;
+    if (profileChosen)
+        for (i= 0;  i <= ruleCount;  ++i)
+            free(profileChosen[i]);
+    free(profileCalls);   profileCalls= 0;
+    free(profileFails);   profileFails= 0;
+    free(profileChosen);  profileChosen= 0;
+    free(profileChoices); profileChoices= 0;
+    free(choiceOf);	  choiceOf= 0;  choiceOfSize= 0;
+    free(choiceCount);	  choiceCount= 0;
+    profileCount= 0;
+}
 
-        case Action:
-            fprintf(output, "  YY_END;");
-            fprintf(output, "  yyDo(yy, yy%s, yypos0, yy->__end);", node->action.name);
-            break;
+/* Answer how likely a call to rule is to fail: rules that the profile
+ * shows failing in at most one call in sixteen (or all but one in
+ * sixteen) are hinted whatever the position of the call.
+ */
+static int Rule_hint(Code *code, Node *rule)
+{
+    unsigned long calls, fails;
+    if (profileCount && (calls= profileCalls[rule->rule.id]))
+    {
+        fails= profileFails[rule->rule.id];
+        if (fails * 16 <= calls)	return 1;
+        if (fails * 16 >= calls * 15)	return -1;
+    }
+    return code->hint;
+}
 
-        case Predicate:
-            fprintf(output, "  yyText(yy, yy->__begin, yy->__end);  if (!(%s)) goto l%d;", node->action.text, ko);
-            break;
+static struct {
+    int	  effect;
+    char *local;
+    char *field;
+    char *type;
+} stateFields[]= {
+    { EffectPos,	"yypos",	"yy->__pos",		"YY_OFFSET" },
+    { EffectThunks,	"yythunkpos",	"yy->__thunkpos",	"int" },
+    { EffectBegin,	"yybegin",	"yy->__begin",		"YY_OFFSET" },
+    { EffectEnd,	"yyend",	"yy->__end",		"YY_OFFSET" },
+    { EffectNodes,	"yynodes",	"yy->__nodecount",	"int" },
+    { 0 }
+};
 
-        case Error:
-            {
-                int eok= yyl(), eko= yyl();
-                Node_compile_c_ko(node->error.element, eko);
-                jump(eok);
-                label(eko);
-                fprintf(output, "  yyText(yy, yy->__begin, yy->__end);  {\n");
-                fprintf(output, "#define yytext yy->__text\n");
-                fprintf(output, "#define yyleng yy->__textlen\n");
-                fprintf(output, "  %s;\n", node->error.text);
-                fprintf(output, "#undef yytext\n");
-                fprintf(output, "#undef yyleng\n");
-                fprintf(output, "  }");
-                jump(ko);
-                label(eok);
-            }
-            break;
+static char *stateField(Code *code, int i)
+{
+    return (code->scanning && EffectPos == stateFields[i].effect) ? "yyp" : stateFields[i].field;
+}
 
-        case Alternate:
-            {
-                int ok= yyl();
-                begin();
-                save(ok);
-                for (node= node->alternate.first;  node;  node= node->alternate.next)
-                    if (node->alternate.next)
-                    {
-                        int next= yyl();
-                        Node_compile_c_ko(node, next);
-                        jump(ok);
-                        label(next);
-                        restore(ok);
-                    }
-                    else
-                        Node_compile_c_ko(node, ko);
-                end();
-                label(ok);
-            }
-            break;
+/* Save (restore) only the parts of the state named by effects. */
+
+static void save(Code *code, int n, int effects)
+{
+    int i;
+    for (i= 0;  stateFields[i].effect;  ++i)
+        if (effects & stateFields[i].effect)
+            Buffer_printf(&code->buf, "  %s %s%d= %s;", stateFields[i].type, stateFields[i].local, n, stateField(code, i));
+}
 
+static void restore(Code *code, int n, int effects)
+{
+    int i;
+    for (i= 0;  stateFields[i].effect;  ++i)
+        if (effects & stateFields[i].effect)
+            Buffer_printf(&code->buf, "  %s= %s%d;", stateField(code, i), stateFields[i].local, n);
+}
+
+/* Answer the parts of the state that node may change, on success or on
+ * failure.  Calling a rule changes whatever the rule may change (see
+ * Rule_effects()); semantic predicates and error actions are arbitrary
+ * code and may change anything.
+ */
+static int Node_effects(Node *node)
+{
+    int effects= 0;
+    switch (node->type)
+    {
+        case Dot:
+        case Character:
+        case String:
+        case Class:		return EffectPos;
+        case Name:		return node->name.rule->rule.effects | (node->name.variable ? EffectThunks : 0);
+        case Action:		return EffectThunks | EffectEnd;
+        case Predicate:
+            if (!strcmp(node->predicate.text, "YY_BEGIN"))	return EffectBegin;
+            if (!strcmp(node->predicate.text, "YY_END"))	return EffectEnd;
+            return EffectAll;
+        case Error:		return EffectAll;
+        case Alternate:
+            for (node= node->alternate.first;  node;  node= node->alternate.next)
+                effects |= Node_effects(node);
+            return effects;
         case Sequence:
             for (node= node->sequence.first;  node;  node= node->sequence.next)
-                Node_compile_c_ko(node, ko);
-            break;
-
+                effects |= Node_effects(node);
+            return effects;
         case PeekFor:
-            {
-                int ok= yyl();
-                begin();
-                save(ok);
-                Node_compile_c_ko(node->peekFor.element, ko);
-                restore(ok);
-                end();
-            }
-            break;
+        case PeekNot:
+        case Query:
+        case Star:
+        case Plus:		return Node_effects(node->query.element);
+        default:
+            fprintf(stderr, "\nNode_effects: illegal node type %d\n", node->type);
+            exit(1);
+    }
+    return effects;
+}
 
+/* Answer the parts of the state on entry to its rule that node refers
+ * to: actions are passed the starting position, and predicates and
+ * error actions may use any of it (e.g., YYACCEPT uses yythunkpos0).
+ */
+static int Node_entryState(Node *node)
+{
+    int state= 0;
+    switch (node->type)
+    {
+        case Action:		return EffectPos;
+        case Predicate:		return (strcmp(node->predicate.text, "YY_BEGIN") && strcmp(node->predicate.text, "YY_END")) ? EffectAll : 0;
+        case Error:		return EffectAll;
+        case Alternate:
+            for (node= node->alternate.first;  node;  node= node->alternate.next)
+                state |= Node_entryState(node);
+            return state;
+        case Sequence:
+            for (node= node->sequence.first;  node;  node= node->sequence.next)
+                state |= Node_entryState(node);
+            return state;
+        case PeekFor:
         case PeekNot:
+        case Query:
+        case Star:
+        case Plus:		return Node_entryState(node->query.element);
+    }
+    return state;
+}
+
+/* Find the effects of every rule.  A rule always sets __begin on
+ * entry (its frame of variables is gone again when it returns); beyond
+ * that it has the effects of its expression, which may depend on other
+ * rules, so iterate until nothing changes.
+ */
+static void Rule_effects(Node *rules)
+{
+    int changed= 1;
+    Node *n;
+
+    for (n= rules;  n;  n= n->rule.next)
+        n->rule.effects= 0;
+    while (changed)
+    {
+        changed= 0;
+        for (n= rules;  n;  n= n->rule.next)
+        {
+            int effects= EffectBegin | (parseTree ? EffectNodes : 0);
+            if (n->rule.expression)
+                effects |= Node_effects(n->rule.expression);
+            if (effects != n->rule.effects)
             {
-                int ok= yyl();
-                begin();
-                save(ok);
-                Node_compile_c_ko(node->peekFor.element, ok);
-                jump(ko);
-                label(ok);
-                restore(ok);
-                end();
+                n->rule.effects= effects;
+                changed= 1;
             }
-            break;
+        }
+    }
+}
 
-        case Query:
+/* Answer whether node always succeeds, whatever the input. */
+static int Node_neverFails(Node *node)
+{
+    switch (node->type)
+    {
+        case Name:
             {
-                int qko= yyl(), qok= yyl();
-                begin();
-                save(qko);
-                Node_compile_c_ko(node->query.element, qko);
-                jump(qok);
-                label(qko);
-                restore(qko);
-                end();
-                label(qok);
+                Node *rule= node->name.rule;
+                int result= 0;
+                if (!rule->rule.expression || (RuleReached & rule->rule.flags))
+                    return 0;
+                rule->rule.flags |= RuleReached;
+                result= Node_neverFails(rule->rule.expression);
+                rule->rule.flags &= ~RuleReached;
+                return result;
             }
-            break;
+        case String:		return !*node->string.value;
+        case Action:
+        case Query:
+        case Star:		return 1;
+        case Predicate:		return !strcmp(node->predicate.text, "YY_BEGIN") || !strcmp(node->predicate.text, "YY_END");
+        case Error:		return Node_neverFails(node->error.element);
+        case Plus:		return Node_neverFails(node->plus.element);
+        case Alternate:
+            for (node= node->alternate.first;  node;  node= node->alternate.next)
+                if (Node_neverFails(node)) return 1;
+            return 0;
+        case Sequence:
+            for (node= node->sequence.first;  node;  node= node->sequence.next)
+                if (!Node_neverFails(node)) return 0;
+            return 1;
+    }
+    return 0;
+}
 
-        case Star:
+/* Visit node, which is committed if nothing can fail after it succeeds
+ * that would backtrack over it.  Calls from uncommitted places make
+ * their rules uncommitted; once rules are settled, actions in committed
+ * places become eager.  Answer whether any rule changed.
+ */
+static int Node_commit(Node *node, int committed, int mark)
+{
+    int changed= 0;
+    switch (node->type)
+    {
+        case Name:
+            if (!committed && (RuleCommitted & node->name.rule->rule.flags))
             {
-                int again= yyl(), out= yyl();
-                label(again);
-                begin();
-                save(out);
-                Node_compile_c_ko(node->star.element, out);
-                jump(again);
-                label(out);
-                restore(out);
-                end();
+                node->name.rule->rule.flags &= ~RuleCommitted;
+                changed= 1;
             }
             break;
-
-        case Plus:
+        case Action:
+            if (mark && (committed || (ActionForced & node->action.flags)))
+                node->action.flags |= ActionEager;
+            break;
+        case Error:		return Node_commit(node->error.element, committed, mark);
+        case Alternate:
+            for (node= node->alternate.first;  node;  node= node->alternate.next)
+                changed |= Node_commit(node, committed, mark);
+            break;
+        case Sequence:
+            for (node= node->sequence.first;  node;  node= node->sequence.next)
             {
-                int again= yyl(), out= yyl();
-                Node_compile_c_ko(node->plus.element, ko);
-                label(again);
-                begin();
-                save(out);
-                Node_compile_c_ko(node->plus.element, out);
-                jump(again);
-                label(out);
-                restore(out);
-                end();
+                Node *n;
+                int   rest= committed;
+                for (n= node->sequence.next;  rest && n;  n= n->sequence.next)
+                    rest= Node_neverFails(n);
+                changed |= Node_commit(node, rest, mark);
             }
             break;
-
-        default:
-            fprintf(stderr, "\nNode_compile_c_ko: illegal node type %d\n", node->type);
-            exit(1);
+        case PeekFor:
+        case PeekNot:		return Node_commit(node->query.element, 0, mark);
+        case Query:
+        case Star:
+        case Plus:		return Node_commit(node->query.element, committed, mark);
     }
+    return changed;
 }
 
-
-static int countVariables(Node *node)
+/* Find the actions that no backtracking can undo once they are reached
+ * and run them there, rather than deferring them until the parse is
+ * complete.  Every rule is committed until some call to it is not (any
+ * rule may be passed to yyparsefrom(), so there is no need to know
+ * which are entry points), which may uncommit the rules it calls, so
+ * iterate until nothing changes.  Actions written {! ... } are always
+ * eager.
+ */
+static void Rule_findEager(Node *rules)
 {
-    int count= 0;
-    while (node)
+    int changed= 1;
+    Node *n;
+
+    for (n= rules;  n;  n= n->rule.next)
+        n->rule.flags |= RuleCommitted;
+    while (changed)
     {
-        ++count;
-        node= node->variable.next;
+        changed= 0;
+        for (n= rules;  n;  n= n->rule.next)
+            if (n->rule.expression)
+                changed |= Node_commit(n->rule.expression, RuleCommitted & n->rule.flags, 0);
     }
-    return count;
+    for (n= rules;  n;  n= n->rule.next)
+        if (n->rule.expression)
+            Node_commit(n->rule.expression, RuleCommitted & n->rule.flags, 1);
 }
 
-static void defineVariables(Node *node)
+/* Set bits to the bytes that can begin a match of node and answer 1,
+ * or answer 0 if node can succeed without consuming input or its first
+ * byte is not known.  visiting marks the rules being entered, by id, to
+ * stop at left recursion.
+ */
+int Node_firstSet(Node *node, unsigned char bits[32], char *visiting)
 {
-    int count= 0;
-    while (node)
+    unsigned char more[32], *text;
+    int		  c, i, ok;
+
+    switch (node->type)
     {
-        fprintf(output, "#define %s yy->__val[%d]\n", node->variable.name, --count);
-        node->variable.offset= count;
-        node= node->variable.next;
+        case Dot:
+            memset(bits, 255, 32);
+            return 1;
+
+        case Character:
+        case String:
+            text= (unsigned char *)node->string.value;
+            if (!(c= Char_next(&text)))
+                return 0;
+            memset(bits, 0, 32);
+            charClassSet(bits, c);
+            if (String == node->type && (StringCaseless & node->string.flags) && c < 128 && isalpha(c))
+            {
+                charClassSet(bits, tolower(c));
+                charClassSet(bits, toupper(c));
+            }
+            return 1;
+
+        case Class:
+            Class_bits(bits, node->cclass.value);
+            return 1;
+
+        case Name:
+            if (visiting[node->name.rule->rule.id] || !node->name.rule->rule.expression)
+                return 0;
+            visiting[node->name.rule->rule.id]= 1;
+            ok= Node_firstSet(node->name.rule->rule.expression, bits, visiting);
+            visiting[node->name.rule->rule.id]= 0;
+            return ok;
+
+        case Error:		return Node_firstSet(node->error.element, bits, visiting);
+        case Plus:		return Node_firstSet(node->plus.element, bits, visiting);
+
+        case Alternate:
+            memset(bits, 0, 32);
+            for (node= node->alternate.first;  node;  node= node->alternate.next)
+            {
+                if (!Node_firstSet(node, more, visiting))
+                    return 0;
+                for (i= 0;  i < 32;  ++i)
+                    bits[i] |= more[i];
+            }
+            return 1;
+
+        case Sequence:
+            memset(bits, 0, 32);
+            for (node= node->sequence.first;  node;  node= node->sequence.next)
+                switch (node->type)
+                {
+                    case Action:
+                    case Predicate:
+                    case PeekFor:
+                    case PeekNot:
+                        break;
+                    default:
+                        if (!Node_firstSet((Query == node->type || Star == node->type) ? node->query.element : node, more, visiting))
+                            return 0;
+                        for (i= 0;  i < 32;  ++i)
+                            bits[i] |= more[i];
+                        if (Query != node->type && Star != node->type)
+                            return 1;
+                }
+            return 0;
     }
-    fprintf(output, "#define __ yy->__\n");
-    fprintf(output, "#define yypos yy->__pos\n");
-    fprintf(output, "#define yythunkpos yy->__thunkpos\n");
+    return 0;
 }
 
-static void undefineVariables(Node *node)
+/* Number the alternatives of every choice in node, in the order in
+ * which they are written, continuing from *count.  This is done before
+ * any reordering, so that the numbers used to count the successes of
+ * alternatives (see YY_CHOSEN) always name the same ones.
+ */
+static void Node_numberChoices(Node *node, int *count)
 {
-    fprintf(output, "#undef yythunkpos\n");
-    fprintf(output, "#undef yypos\n");
-    fprintf(output, "#undef yy\n");
-    while (node)
-    {
-        fprintf(output, "#undef %s\n", node->variable.name);
-        node= node->variable.next;
-    }
+    for (;  node;  node= node->any.next)
+        switch (node->type)
+        {
+            case Alternate:
+                {
+                    Node *n;
+                    for (n= node->alternate.first;  n;  n= n->alternate.next)
+                    {
+                        if (n->node_id >= choiceOfSize)
+                        {
+                            int size= choiceOfSize;
+                            choiceOfSize= 2 * n->node_id + 64;
+                            choiceOf= realloc(choiceOf, sizeof(int) * choiceOfSize);
+                            memset(choiceOf + size, 0, sizeof(int) * (choiceOfSize - size));
+                        }
+                        choiceOf[n->node_id]= (*count)++;
+                    }
+                    Node_numberChoices(node->alternate.first, count);
+                }
+                break;
+            case Error:		Node_numberChoices(node->error.element, count);	break;
+            case Sequence:	Node_numberChoices(node->sequence.first, count);	break;
+            case PeekFor:
+            case PeekNot:
+            case Query:
+            case Star:
+            case Plus:		Node_numberChoices(node->query.element, count);		break;
+        }
 }
 
+/* Answer whether trying node can have an effect that survives its
+ * failure: a semantic predicate, an error action or an action written
+ * {! ... } might be run on the way to it, here or in a rule it calls.
+ */
+static int Node_hasEffects(Node *node, char *visiting)
+{
+    for (;  node;  node= node->any.next)
+        switch (node->type)
+        {
+            case Name:
+                if (!visiting[node->name.rule->rule.id])
+                {
+                    visiting[node->name.rule->rule.id]= 1;
+                    if (node->name.rule->rule.expression && Node_hasEffects(node->name.rule->rule.expression, visiting))
+                        return 1;
+                }
+                break;
+            case Action:
+                if ((ActionForced | ActionEager) & node->action.flags) return 1;
+                break;
+            case Predicate:
+                if (strcmp(node->predicate.text, "YY_BEGIN") && strcmp(node->predicate.text, "YY_END")) return 1;
+                break;
+            case Error:		return 1;
+            case Alternate:	if (Node_hasEffects(node->alternate.first, visiting)) return 1;	break;
+            case Sequence:	if (Node_hasEffects(node->sequence.first, visiting)) return 1;	break;
+            case PeekFor:
+            case PeekNot:
+            case Query:
+            case Star:
+            case Plus:		if (Node_hasEffects(node->query.element, visiting)) return 1;	break;
+        }
+    return 0;
+}
 
-static void Rule_compile_c2(Node *node)
+/* Mark the rules whose results may be memoized when YY_MEMO is defined:
+ * those that are not tokens and, like the rules they call, have no
+ * effects other than the thunks they record, which can be replayed.
+ * Rules that build parse tree nodes are never memoized.
+ */
+static void Rule_findMemo(Node *rules)
 {
-    assert(node);
-    assert(Rule == node->type);
+    char *visiting= malloc(ruleCount + 1);
+    Node *n;
 
-    if (!node->rule.expression)
-        fprintf(stderr, "rule '%s' used but not defined\n", node->rule.name);
-    else
+    for (n= rules;  n;  n= n->rule.next)
     {
-        int ko= yyl(), safe;
-
-        if ((!(RuleUsed & node->rule.flags)) && (node != start))
-            fprintf(stderr, "rule '%s' defined but not used\n", node->rule.name);
+        n->rule.flags &= ~RuleMemo;
+        if (parseTree || !n->rule.expression || (RuleToken & n->rule.flags))
+            continue;
+        memset(visiting, 0, ruleCount + 1);
+        visiting[n->rule.id]= 1;
+        if (!Node_hasEffects(n->rule.expression, visiting))
+            n->rule.flags |= RuleMemo;
+    }
+    free(visiting);
+}
 
-        safe= ((Query == node->rule.expression->type) || (Star == node->rule.expression->type));
+/* Answer whether at most one alternative of node can match anywhere,
+ * because each must consume input and no two can begin with the same
+ * byte, and none has effects that depend on the order they are tried
+ * in.  Their order then makes no difference to what is matched.
+ */
+static int Alternate_disjoint(Node *node)
+{
+    unsigned char all[32], bits[32];
+    char	 *visiting= calloc(ruleCount + 1, 1);
+    int		  i, ok= 1;
 
-        fprintf(output, "\nYY_RULE(int) yy_%s(yycontext *yy)\n{", node->rule.name);
-        if (!safe) save(0);
-        if (node->rule.variables)
-            fprintf(output, "  yyDo(yy, yyPush, %d, 0);", countVariables(node->rule.variables));
-        fprintf(output, "\n  yyprintf((stderr, \"%%s\\n\", \"%s\"));", node->rule.name);
-        fprintf(output, "  YY_BEGIN;");
-        Node_compile_c_ko(node->rule.expression, ko);
-        fprintf(output, "\n  yyprintf((stderr, \"  ok   %%s @ %%s\\n\", \"%s\", yy->__buf+yy->__pos));", node->rule.name);
-        if (node->rule.variables)
-            fprintf(output, "  yyDo(yy, yyPop, %d, 0);", countVariables(node->rule.variables));
-        fprintf(output, "\n  return 1;");
-        if (!safe)
+    memset(all, 0, 32);
+    for (node= node->alternate.first;  ok && node;  node= node->alternate.next)
+    {
+        if (!Node_firstSet(node, bits, visiting))
+            ok= 0;
+        for (i= 0;  ok && i < 32;  ++i)
         {
-            label(ko);
-            restore(0);
-            fprintf(output, "\n  yyprintf((stderr, \"  fail %%s @ %%s\\n\", \"%s\", yy->__buf+yy->__pos));", node->rule.name);
-            fprintf(output, "\n  return 0;");
+            if (all[i] & bits[i]) ok= 0;
+            all[i] |= bits[i];
         }
-        fprintf(output, "\n}");
+        memset(visiting, 0, ruleCount + 1);
+        if (ok && Node_hasEffects(node, visiting))
+            ok= 0;
+        memset(visiting, 0, ruleCount + 1);
+    }
+    free(visiting);
+    return ok;
+}
+
+/* Put the alternatives of each choice in node in decreasing order of
+ * the number of successes in chosen (see Rule_readProfile()), wherever
+ * their order does not matter, so that the one that usually matches
+ * is tried first.  Ties keep the order in which they were written.
+ */
+static void Node_reorder(Node *node, unsigned long *chosen)
+{
+    for (;  node;  node= node->any.next)
+        switch (node->type)
+        {
+            case Alternate:
+                Node_reorder(node->alternate.first, chosen);
+                if (Alternate_disjoint(node))
+                {
+                    Node *sorted= 0, *n, *next, **p;
+                    for (n= node->alternate.first;  n;  n= next)
+                    {
+                        next= n->alternate.next;
+                        for (p= &sorted;  *p && chosen[choiceOf[(*p)->node_id]] >= chosen[choiceOf[n->node_id]];  p= &(*p)->alternate.next);
+                        n->alternate.next= *p;
+                        *p= n;
+                    }
+                    node->alternate.first= sorted;
+                    for (n= sorted;  n;  n= n->alternate.next)
+                        node->alternate.last= n;
+                }
+                break;
+            case Error:		Node_reorder(node->error.element, chosen);	break;
+            case Sequence:	Node_reorder(node->sequence.first, chosen);	break;
+            case PeekFor:
+            case PeekNot:
+            case Query:
+            case Star:
+            case Plus:		Node_reorder(node->query.element, chosen);	break;
+        }
+}
+
+/* Number the alternatives of every rule and, given a profile, reorder
+ * them.  The counts for a rule are ignored unless there is one for
+ * each of its alternatives, since otherwise the grammar has changed.
+ */
+static void Rule_reorder(Node *rules)
+{
+    Node *n;
+
+    choiceCount= calloc(ruleCount + 1, sizeof(int));
+    for (n= rules;  n;  n= n->rule.next)
+        if (n->rule.expression)
+            Node_numberChoices(n->rule.expression, &choiceCount[n->rule.id]);
+    if (profileCount)
+        for (n= rules;  n;  n= n->rule.next)
+            if (n->rule.expression && !(RuleToken & n->rule.flags) && choiceCount[n->rule.id])
+            {
+                if (choiceCount[n->rule.id] == profileChoices[n->rule.id])
+                    Node_reorder(n->rule.expression, profileChosen[n->rule.id]);
+                else if (profileCalls[n->rule.id])
+                    fprintf(stderr, "%s: rule '%s' has changed; ignoring its alternatives\n", profileName, n->rule.name);
+            }
+}
+
+/* Number the alternatives of node in map by the bytes that can start
+ * them, and answer whether every alternative starts with a class and
+ * no two of those classes share a byte.  The next byte then picks the
+ * only alternative that can match, as it does in the classes of code
+ * points built by Class_unicode().
+ */
+static int Alternate_dispatch(Node *node, unsigned char map[256], unsigned char any[32])
+{
+    unsigned char bits[32];
+    int		  count= 0, c;
+
+    memset(map, 0, 256);
+    memset(any, 0, 32);
+    for (node= node->alternate.first;  node;  node= node->alternate.next)
+    {
+        Node *first= (Sequence == node->type) ? node->sequence.first : node;
+        if (Class != first->type || ++count > 255) return 0;
+        Class_bits(bits, first->cclass.value);
+        for (c= 0;  c < 256;  ++c)
+            if (bits[c >> 3] & (1 << (c & 7)))
+            {
+                if (map[c]) return 0;
+                map[c]= count;
+            }
+        for (c= 0;  c < 32;  ++c)
+            any[c] |= bits[c];
+    }
+    return count > 1;
+}
+
+/* Compile a case-insensitive literal into a single call that compares
+ * it word by word against the input (see yyfold in the preamble), or a
+ * class if it is a single letter.  Answer 0 if the literal contains no
+ * letters and can be matched exactly instead.
+ */
+static int String_compile_caseless(Code *code, Node *node, int ko)
+{
+    Buffer lower, mask;
+    int    n, letters;
+    char  *on= hintOn(code->hint), *off= hintOff(code->hint);
+
+    Buffer_init(&lower);
+    Buffer_init(&mask);
+    if ((letters= String_fold(&lower, &mask, &n, node->string.value)) && 1 == n)
+    {
+        unsigned char bits[32], *text= (unsigned char *)node->string.value;
+        int	      c= tolower(Char_next(&text)), i;
+        memset(bits, 0, sizeof(bits));
+        charClassSet(bits, c);
+        charClassSet(bits, toupper(c));
+        if (code->scanning)
+            Buffer_printf(&code->buf, "  if (%s!yyavail(yy, yyp) || !yyinclass((unsigned char *)\"", on);
+        else
+            Buffer_printf(&code->buf, "  if (%s!yymatchClass(yy, (unsigned char *)\"", on);
+        for (i= 0;  i < 32;  ++i)
+            Buffer_printf(&code->buf, "\\%03o", bits[i]);
+        if (code->scanning)
+            Buffer_printf(&code->buf, "\", yy->__buf[yyp])%s) goto l%d;  ++yyp;", off, ko);
+        else
+            Buffer_printf(&code->buf, "\")%s) goto l%d;", off, ko);
+    }
+    else if (letters)
+    {
+        if (code->scanning)
+        {
+            unsigned char *text= (unsigned char *)node->string.value;
+            int		   c= Char_next(&text);
+            if (c < 128 && isalpha(c))	/* most candidates are rejected by their first byte */
+                Buffer_printf(&code->buf, "  if (%s!yyavail(yy, yyp) || (yy->__buf[yyp] | 0x20) != '%c'%s) goto l%d;", on, tolower(c), off, ko);
+            Buffer_printf(&code->buf, "  {  int yyn= yyscanCaseless(yy, yyp, \"%s\", \"%s\", %d);  if (%syyn < 0%s) goto l%d;  yyp += yyn;  }", lower.text, mask.text, n, on, off, ko);
+        }
+        else
+            Buffer_printf(&code->buf, "  if (%s!yymatchCaseless(yy, \"%s\", \"%s\", %d)%s) goto l%d;", on, lower.text, mask.text, n, off, ko);
+    }
+    Buffer_release(&lower);
+    Buffer_release(&mask);
+    return letters;
+}
+
+static void Node_compile_c_ko(Code *code, Node *node, int ko);
+
+/* The failure of a test is hinted as unlikely once its sequence has got
+ * past its first element, which is what usually decides between the
+ * alternatives of a choice or ends a loop.  The elements of choices,
+ * loops, options and predicates start without a hint of their own.
+ */
+static void Node_compile_c_elements(Code *code, Node *node, int ko)
+{
+    int hint= code->hint;
+    for (;  node;  node= node->sequence.next)
+    {
+        Node_compile_c_ko(code, node, ko);
+        if (Action != node->type && Predicate != node->type)
+            code->hint= 1;
+    }
+    code->hint= hint;
+}
+
+static void Node_compile_c_unhinted(Code *code, Node *node, int ko)
+{
+    int hint= code->hint;
+    code->hint= 0;
+    Node_compile_c_ko(code, node, ko);
+    code->hint= hint;
+}
+
+static void Node_compile_c_ko(Code *code, Node *node, int ko)
+{
+    unsigned char map[256], any[32];
+    char	 *on= hintOn(code->hint), *off= hintOff(code->hint);
+
+    assert(node);
+    switch (node->type)
+    {
+        case Rule:
+            fprintf(stderr, "\ninternal error #1 (%s)\n", node->rule.name);
+            exit(1);
+            break;
+
+        case Dot:
+            if (code->scanning)
+                Buffer_printf(&code->buf, "  if (%s!yyavail(yy, yyp)%s) goto l%d;  ++yyp;", on, off, ko);
+            else
+                Buffer_printf(&code->buf, "  if (%s!yymatchDot(yy)%s) goto l%d;", on, off, ko);
+            break;
+
+        case Name:
+            on= hintOn(Rule_hint(code, node->name.rule));
+            off= hintOff(Rule_hint(code, node->name.rule));
+            if (RuleToken & node->name.rule->rule.flags)
+            {
+                if (code->scanning)
+                    Buffer_printf(&code->buf, "  {  YY_OFFSET yyn= yyscan_%s(yy, yyp);  if (%syyn < 0%s) goto l%d;  yyp += yyn;", node->name.rule->rule.name, on, off, ko);
+                else
+                    Buffer_printf(&code->buf, "  {  YY_OFFSET yyn= yyscan_%s(yy, yy->__pos);  if (%syyn < 0%s) { yyexpect(yy, YYEXPECT_RULE, 0, \"%s\");  goto l%d; }  yy->__pos += yyn;", node->name.rule->rule.name, on, off, node->name.rule->rule.name, ko);
+                if (parseTree && !code->scanning)
+                    Buffer_printf(&code->buf, "  yyNodeLeaf(yy, %d, yyn);", node->name.rule->rule.id);
+                Buffer_printf(&code->buf, "  }");
+                if (node->name.variable && !node->name.setter)
+                    Buffer_printf(&code->buf, "  yyDo(yy, yySet, %d, 0);", node->name.variable->variable.offset);
+                break;
+            }
+            Buffer_printf(&code->buf, "  if (%s!yy_%s(yy)%s) goto l%d;", on, node->name.rule->rule.name, off, ko);
+            if (node->name.variable && !node->name.setter)
+                Buffer_printf(&code->buf, "  yyDo(yy, yySet, %d, 0);", node->name.variable->variable.offset);
+            break;
+
+        case Character:
+        case String:
+            if (String == node->type && (StringCaseless & node->string.flags) && String_compile_caseless(code, node, ko))
+                break;
+            {
+                int len= strlen(node->string.value);
+                if (code->scanning)
+                {
+                    if (1 == len && '\'' == node->string.value[0])
+                        Buffer_printf(&code->buf, "  if (%s!yyavail(yy, yyp) || '\\'' != yy->__buf[yyp]%s) goto l%d;  ++yyp;", on, off, ko);
+                    else if (1 == len || (2 == len && '\\' == node->string.value[0]))
+                        Buffer_printf(&code->buf, "  if (%s!yyavail(yy, yyp) || '%s' != yy->__buf[yyp]%s) goto l%d;  ++yyp;", on, node->string.value, off, ko);
+                    else if (len)
+                        Buffer_printf(&code->buf, "  {  int yyn= yyscanString(yy, yyp, \"%s\");  if (%syyn < 0%s) goto l%d;  yyp += yyn;  }", node->string.value, on, off, ko);
+                }
+                else if (1 == len)
+                {
+                    if ('\'' == node->string.value[0])
+                        Buffer_printf(&code->buf, "  if (%s!yymatchChar(yy, '\\'')%s) goto l%d;", on, off, ko);
+                    else
+                        Buffer_printf(&code->buf, "  if (%s!yymatchChar(yy, '%s')%s) goto l%d;", on, node->string.value, off, ko);
+                }
+                else
+                    if (2 == len && '\\' == node->string.value[0])
+                        Buffer_printf(&code->buf, "  if (%s!yymatchChar(yy, '%s')%s) goto l%d;", on, node->string.value, off, ko);
+                    else
+                        Buffer_printf(&code->buf, "  if (%s!yymatchString(yy, \"%s\")%s) goto l%d;", on, node->string.value, off, ko);
+            }
+            break;
+
+        case Class:
+            if (code->scanning)
+            {
+                Buffer_printf(&code->buf, "  if (%s!yyavail(yy, yyp) || !yyinclass((unsigned char *)\"", on);
+                Class_compile_c(&code->buf, node->cclass.value);
+                Buffer_printf(&code->buf, "\", yy->__buf[yyp])%s) goto l%d;  ++yyp;", off, ko);
+                break;
+            }
+            Buffer_printf(&code->buf, "  if (%s!yymatchClass(yy, (unsigned char *)\"", on);
+            Class_compile_c(&code->buf, node->cclass.value);
+            Buffer_printf(&code->buf, "\")%s) goto l%d;", off, ko);
+            break;
+
+        case Action:
+            Buffer_printf(&code->buf, "  (void)YY_END;");
+            if (ActionEager & node->action.flags)	/* run everything before it first, unless finding what was expected */
+            {
+                Buffer_printf(&code->buf, "  if (YY_LIKELY(!yy->__expecting)) {  yyDone(yy);");
+                if (node->action.rule->rule.variables)
+                    Buffer_printf(&code->buf, "  yy->__val= yy->__vals + yy->__frame;");
+                Buffer_printf(&code->buf, "  yy%s(yy, yypos0, yy->__end);  }", node->action.name);
+            }
+            else
+                Buffer_printf(&code->buf, "  yyDo(yy, yy%s, yypos0, yy->__end);", node->action.name);
+            break;
+
+        case Predicate:
+            if (code->scanning)	/* only '<' and '>' occur in scanners */
+                Buffer_printf(&code->buf, "  yy->__%s= yyp;", strcmp(node->predicate.text, "YY_BEGIN") ? "end" : "begin");
+            else
+                Buffer_printf(&code->buf, "  if (!(%s)) goto l%d;", node->action.text, ko);
+            break;
+
+        case Error:
+            {
+                int eok= yyl(code), eko= yyl(code);
+                Node_compile_c_ko(code, node->error.element, eko);
+                jump(code, eok);
+                label(code, eko);
+                Buffer_printf(&code->buf, "  if (!yy->__expecting) {  YY_OFFSET yybegin YY_UNUSED= yy->__begin, yyend YY_UNUSED= yy->__end;\n");
+                Buffer_printf(&code->buf, "  %s;\n", node->error.text);
+                Buffer_printf(&code->buf, "  }");
+                jump(code, ko);
+                label(code, eok);
+            }
+            break;
+
+        case Alternate:
+            if (Alternate_dispatch(node, map, any))
+            {
+                char *pos= code->scanning ? "yyp" : "yy->__pos";
+                int   ok= yyl(code), count= 0, c;
+                Buffer_printf(&code->buf, "\n  switch (yyavail(yy, %s) ? ((unsigned char *)\"", pos);
+                for (c= 0;  c < 256;  ++c)
+                    Buffer_printf(&code->buf, "\\%03o", map[c]);
+                Buffer_printf(&code->buf, "\")[(unsigned char)yy->__buf[%s]] : 0)\n  {", pos);
+                for (node= node->alternate.first;  node;  node= node->alternate.next)
+                {
+                    Buffer_printf(&code->buf, "\n  case %d:  ++%s;", ++count, pos);
+                    if (Sequence == node->type)
+                    {
+                        int hint= code->hint;
+                        code->hint= 1;
+                        Node_compile_c_elements(code, node->sequence.first->any.next, ko);
+                        code->hint= hint;
+                    }
+                    if (!code->scanning)
+                        Buffer_printf(&code->buf, "  YY_CHOSEN(%d);", choiceOf[node->node_id]);
+                    jump(code, ok);
+                }
+                Buffer_printf(&code->buf, "\n  default:");
+                if (!code->scanning)
+                {
+                    Buffer_printf(&code->buf, "  yyexpect(yy, YYEXPECT_CLASS, 0, (const char *)\"");
+                    for (c= 0;  c < 32;  ++c)
+                        Buffer_printf(&code->buf, "\\%03o", any[c]);
+                    Buffer_printf(&code->buf, "\");");
+                }
+                jump(code, ko);
+                Buffer_printf(&code->buf, "\n  }");
+                label(code, ok);
+            }
+            else
+            {
+                int ok= yyl(code), effects= Node_effects(node);
+                begin(code);
+                save(code, ok, effects);
+                for (node= node->alternate.first;  node;  node= node->alternate.next)
+                    if (node->alternate.next)
+                    {
+                        int next= yyl(code);
+                        Node_compile_c_unhinted(code, node, next);
+                        if (!code->scanning)
+                            Buffer_printf(&code->buf, "  YY_CHOSEN(%d);", choiceOf[node->node_id]);
+                        jump(code, ok);
+                        label(code, next);
+                        restore(code, ok, effects);
+                    }
+                    else
+                    {
+                        Node_compile_c_unhinted(code, node, ko);
+                        if (!code->scanning)
+                            Buffer_printf(&code->buf, "  YY_CHOSEN(%d);", choiceOf[node->node_id]);
+                    }
+                end(code);
+                label(code, ok);
+            }
+            break;
+
+        case Sequence:
+            Node_compile_c_elements(code, node->sequence.first, ko);
+            break;
+
+        case PeekFor:
+            {
+                int ok= yyl(code), effects= Node_effects(node);
+                begin(code);
+                save(code, ok, effects);
+                Node_compile_c_unhinted(code, node->peekFor.element, ko);
+                restore(code, ok, effects);
+                end(code);
+            }
+            break;
+
+        case PeekNot:
+            {
+                int ok= yyl(code), effects= Node_effects(node);
+                begin(code);
+                save(code, ok, effects);
+                Node_compile_c_unhinted(code, node->peekFor.element, ok);
+                jump(code, ko);
+                label(code, ok);
+                restore(code, ok, effects);
+                end(code);
+            }
+            break;
+
+        case Query:
+            {
+                int qko= yyl(code), qok= yyl(code), effects= Node_effects(node);
+                begin(code);
+                save(code, qko, effects);
+                Node_compile_c_unhinted(code, node->query.element, qko);
+                jump(code, qok);
+                label(code, qko);
+                restore(code, qko, effects);
+                end(code);
+                label(code, qok);
+            }
+            break;
+
+        case Star:
+            {
+                int again= yyl(code), out= yyl(code), effects= Node_effects(node);
+                label(code, again);
+                begin(code);
+                save(code, out, effects);
+                Node_compile_c_unhinted(code, node->star.element, out);
+                jump(code, again);
+                label(code, out);
+                restore(code, out, effects);
+                end(code);
+            }
+            break;
+
+        case Plus:
+            {
+                int again= yyl(code), out= yyl(code), effects= Node_effects(node);
+                Node_compile_c_ko(code, node->plus.element, ko);
+                label(code, again);
+                begin(code);
+                save(code, out, effects);
+                Node_compile_c_unhinted(code, node->plus.element, out);
+                jump(code, again);
+                label(code, out);
+                restore(code, out, effects);
+                end(code);
+            }
+            break;
+
+        default:
+            fprintf(stderr, "\nNode_compile_c_ko: illegal node type %d\n", node->type);
+            exit(1);
+    }
+}
+
+
+static int countVariables(Node *node)
+{
+    int count= 0;
+    while (node)
+    {
+        ++count;
+        node= node->variable.next;
+    }
+    return count;
+}
+
+static void defineVariables(Node *node)
+{
+    while (node)
+    {
+        fprintf(output, "#define %s yy->__val[%d]\n", node->variable.name, node->variable.offset);
+        node= node->variable.next;
+    }
+    fprintf(output, "#define __ yy->__\n");
+    fprintf(output, "#define yypos yy->__pos\n");
+    fprintf(output, "#define yythunkpos yy->__thunkpos\n");
+}
+
+static void undefineVariables(Node *node)
+{
+    fprintf(output, "#undef yythunkpos\n");
+    fprintf(output, "#undef yypos\n");
+    fprintf(output, "#undef yy\n");
+    while (node)
+    {
+        fprintf(output, "#undef %s\n", node->variable.name);
+        node= node->variable.next;
+    }
+}
+
+/* Let the first action after a call that sets a variable set it, when
+ * nothing between the two can record thunks of its own, so that the
+ * call needs no yySet thunk.
+ */
+static void Node_bindings(Node *node)
+{
+    switch (node->type)
+    {
+        case Error:		Node_bindings(node->error.element);	break;
+        case Alternate:
+            for (node= node->alternate.first;  node;  node= node->alternate.next)
+                Node_bindings(node);
+            break;
+        case Sequence:
+            for (node= node->sequence.first;  node;  node= node->sequence.next)
+            {
+                Node *n;
+                if (Name == node->type && node->name.variable)
+                    for (n= node->sequence.next;  n;  n= n->sequence.next)
+                    {
+                        if (Action == n->type && !n->action.binding)
+                        {
+                            n->action.binding= node->name.variable;
+                            node->name.setter= n;
+                            break;
+                        }
+                        if (EffectThunks & Node_effects(n))
+                            break;
+                    }
+                Node_bindings(node);
+            }
+            break;
+        case PeekFor:
+        case PeekNot:
+        case Query:
+        case Star:
+        case Plus:		Node_bindings(node->query.element);	break;
+    }
+}
+
+/* Lay out the frame of every rule with variables.  Frames are reserved
+ * on the value stack while the rule is being parsed and each thunk
+ * remembers the top of the frame that was current when it was recorded,
+ * so that the actions find their variables at fixed offsets below it
+ * without any thunks to push and pop frames when they run.
+ */
+static void Rule_frames(Node *rules)
+{
+    Node *n, *v;
+
+    for (n= rules;  n;  n= n->rule.next)
+    {
+        int count= 0;
+        for (v= n->rule.variables;  v;  v= v->variable.next)
+            v->variable.offset= --count;
+        if (n->rule.expression)
+            Node_bindings(n->rule.expression);
+    }
+}
+
+static void Rule_compile_c2(Code *code, Node *node)
+{
+    int ko= yyl(code), safe, effects;
+
+    assert(node);
+    assert(Rule == node->type);
+    assert(node->rule.expression);
+
+    safe= ((Query == node->rule.expression->type) || (Star == node->rule.expression->type));
+    effects= (safe ? 0 : node->rule.effects) | Node_entryState(node->rule.expression);
+
+    Buffer_printf(&code->buf, "\nYY_RULE(int) yy_%s(yycontext *yy)\n{", node->rule.name);
+    Buffer_printf(&code->buf, "  if (YY_LIMITED(yy)) return 0;");
+    if (RuleMemo & node->rule.flags)
+        Buffer_printf(&code->buf, "  YY_MEMO_ENTER(yy, %d);", node->rule.id);
+    Buffer_printf(&code->buf, "  YY_PROFILED(\"%s\", %d);", node->rule.name, choiceCount[node->rule.id]);
+    save(code, 0, effects);
+    if (parseTree)
+        Buffer_printf(&code->buf, "  int yynode= yyNodeOpen(yy, %d);  if (yynode < 0) return 0;", node->rule.id);
+    if (node->rule.variables)
+    {
+        if (parseTree)
+            Buffer_printf(&code->buf, "  if (!yyFrame(yy, %d)) { yy->__nodecount= yynode;  return 0; }", countVariables(node->rule.variables));
+        else
+            Buffer_printf(&code->buf, "  if (!yyFrame(yy, %d)) return 0;", countVariables(node->rule.variables));
+    }
+    Buffer_printf(&code->buf, "\n  yyprintf((stderr, \"%%s\\n\", \"%s\"));", node->rule.name);
+    Buffer_printf(&code->buf, "  (void)YY_BEGIN;");
+    Node_compile_c_ko(code, node->rule.expression, ko);
+    Buffer_printf(&code->buf, "\n  yyprintf((stderr, \"  ok   %%s @ %%s\\n\", \"%s\", yy->__buf+yy->__pos));", node->rule.name);
+    if (node->rule.variables)
+        Buffer_printf(&code->buf, "  yy->__frame -= %d;", countVariables(node->rule.variables));
+    if (parseTree)
+        Buffer_printf(&code->buf, "  yyNodeClose(yy, yynode);");
+    if (RuleMemo & node->rule.flags)
+        Buffer_printf(&code->buf, "  YY_MEMO_LEAVE(yy, 1);");
+    Buffer_printf(&code->buf, "\n  return 1;");
+    if (!safe)
+    {
+        if (Rule_hint(code, node) > 0)	/* the profile shows that the rule rarely fails */
+            Buffer_printf(&code->buf, "\n  l%d: YY_COLD_LABEL;", ko);
+        else
+            label(code, ko);
+        Buffer_printf(&code->buf, "  YY_FAILED;");
+        restore(code, 0, effects);
+        if (node->rule.variables)
+            Buffer_printf(&code->buf, "  yy->__frame -= %d;", countVariables(node->rule.variables));
+        Buffer_printf(&code->buf, "\n  yyprintf((stderr, \"  fail %%s @ %%s\\n\", \"%s\", yy->__buf+yy->__pos));", node->rule.name);
+        if (RuleMemo & node->rule.flags)
+            Buffer_printf(&code->buf, "  YY_MEMO_LEAVE(yy, 0);");
+        Buffer_printf(&code->buf, "\n  return 0;");
+    }
+    Buffer_printf(&code->buf, "\n}");
+}
+
+/* A token rule is compiled into a scanner that works on a local copy
+ * of the position and answers the length of the text it matched, or -1
+ * if it failed.  Scanners never touch the thunks or the value stack, so
+ * backtracking within them costs only a local assignment.  Regular
+ * tokens become automata instead (see dfa.c).  The rule itself becomes
+ * a wrapper that runs the scanner at the current position.
+ */
+static void Rule_compile_c_token(Code *code, Node *node)
+{
+    Node *first= node->rule.expression;
+    int   ko= yyl(code), safe, effects;
+
+    if (Sequence == first->type)
+        first= first->sequence.first;
+
+    safe= ((Query == node->rule.expression->type) || (Star == node->rule.expression->type));
+    effects= safe ? 0 : node->rule.effects & (EffectBegin | EffectEnd);
+
+    if (!Rule_compile_dfa(&code->buf, node))
+    {
+        code->scanning= 1;
+        Buffer_printf(&code->buf, "\nYY_RULE(YY_OFFSET) yyscan_%s(yycontext *yy, YY_OFFSET yyp0)\n{", node->rule.name);
+        Buffer_printf(&code->buf, "  YY_OFFSET yyp= yyp0;  if (YY_LIMITED(yy)) return -1;");
+        save(code, 0, effects);
+        Buffer_printf(&code->buf, "\n");
+        if (!(Predicate == first->type && !strcmp(first->predicate.text, "YY_BEGIN")))	/* the text begins with '<' */
+            Buffer_printf(&code->buf, "  yy->__begin= yyp;");
+        Node_compile_c_ko(code, node->rule.expression, ko);
+        Buffer_printf(&code->buf, "\n  return yyp - yyp0;");
+        if (!safe)
+        {
+            label(code, ko);
+            restore(code, 0, effects);
+            Buffer_printf(&code->buf, "\n  return -1;");
+        }
+        Buffer_printf(&code->buf, "\n}");
+        code->scanning= 0;
+    }
+
+    Buffer_printf(&code->buf, "\nYY_RULE(int) yy_%s(yycontext *yy)\n{", node->rule.name);
+    Buffer_printf(&code->buf, "  YY_OFFSET yyn;  YY_PROFILED(\"%s\", 0);", node->rule.name);
+    Buffer_printf(&code->buf, "\n  yyprintf((stderr, \"%%s\\n\", \"%s\"));", node->rule.name);
+    Buffer_printf(&code->buf, "\n  if (%s(yyn= yyscan_%s(yy, yy->__pos)) < 0%s)\n  {", hintOn(Rule_hint(code, node)), node->rule.name, hintOff(Rule_hint(code, node)));
+    Buffer_printf(&code->buf, "\n    YY_FAILED;");
+    Buffer_printf(&code->buf, "\n    yyprintf((stderr, \"  fail %%s @ %%s\\n\", \"%s\", yy->__buf+yy->__pos));", node->rule.name);
+    Buffer_printf(&code->buf, "\n    yyexpect(yy, YYEXPECT_RULE, 0, \"%s\");", node->rule.name);
+    Buffer_printf(&code->buf, "\n    return 0;\n  }");
+    Buffer_printf(&code->buf, "\n  yy->__pos += yyn;");
+    if (parseTree)
+        Buffer_printf(&code->buf, "  yyNodeLeaf(yy, %d, yyn);", node->rule.id);
+    Buffer_printf(&code->buf, "\n  yyprintf((stderr, \"  ok   %%s @ %%s\\n\", \"%s\", yy->__buf+yy->__pos));", node->rule.name);
+    Buffer_printf(&code->buf, "\n  return 1;\n}");
+}
+
+/* Answer whether node can be part of a scanner: it matches only
+ * terminals, '<', '>' and calls to other token rules.
+ */
+static int Node_isLexical(Node *node)
+{
+    switch (node->type)
+    {
+        case Dot:
+        case Character:
+        case String:
+        case Class:		return 1;
+        case Name:		return !node->name.variable && (RuleToken & node->name.rule->rule.flags);
+        case Predicate:		return !strcmp(node->predicate.text, "YY_BEGIN") || !strcmp(node->predicate.text, "YY_END");
+        case Action:
+        case Error:		return 0;
+        case Alternate:
+            for (node= node->alternate.first;  node;  node= node->alternate.next)
+                if (!Node_isLexical(node)) return 0;
+            return 1;
+        case Sequence:
+            for (node= node->sequence.first;  node;  node= node->sequence.next)
+                if (!Node_isLexical(node)) return 0;
+            return 1;
+        case PeekFor:
+        case PeekNot:
+        case Query:
+        case Star:
+        case Plus:		return Node_isLexical(node->query.element);
+    }
+    return 0;
+}
+
+/* Make a token of every rule without actions, predicates or variables
+ * that calls only other tokens.  A recursive rule never qualifies,
+ * since it would have to be a token already.
+ */
+static void Rule_findTokens(Node *rules)
+{
+    int changed= 1;
+    Node *n;
+
+    while (changed)
+    {
+        changed= 0;
+        for (n= rules;  n;  n= n->rule.next)
+            if (!(RuleToken & n->rule.flags) && n->rule.expression && !n->rule.variables && Node_isLexical(n->rule.expression))
+            {
+                Rule_beToken(n);
+                changed= 1;
+            }
     }
-
-    if (node->rule.next)
-        Rule_compile_c2(node->rule.next);
 }
 
 static char *header= "\
 #include <stdio.h>\n\
 #include <stdlib.h>\n\
+#include <stddef.h>\n\
 #include <string.h>\n\
 ";
 
@@ -411,6 +1464,33 @@ static char *preamble= "\
 #ifndef YYRELEASE\n\
 #define YYRELEASE	yyrelease\n\
 #endif\n\
+#ifndef YYEXPECTED\n\
+#define YYEXPECTED	yyexpected\n\
+#endif\n\
+#ifndef YYPARSEBATCH\n\
+#define YYPARSEBATCH	yyparsebatch\n\
+#endif\n\
+#ifndef YYACQUIRE\n\
+#define YYACQUIRE	yyacquire\n\
+#endif\n\
+#ifndef YYRECYCLE\n\
+#define YYRECYCLE	yyrecycle\n\
+#endif\n\
+#ifndef YYDRAIN\n\
+#define YYDRAIN		yydrain\n\
+#endif\n\
+#ifndef YYLIMIT\n\
+#define YYLIMIT		yylimit\n\
+#endif\n\
+#ifndef YYLIMITED\n\
+#define YYLIMITED	yylimited\n\
+#endif\n\
+#ifndef YYINVALID\n\
+#define YYINVALID	yyinvalid\n\
+#endif\n\
+#ifndef YYPROFILE\n\
+#define YYPROFILE	yyprofile\n\
+#endif\n\
 #ifndef YY_BEGIN\n\
 #define YY_BEGIN	( yy->__begin= yy->__pos, 1)\n\
 #endif\n\
@@ -422,6 +1502,33 @@ static char *preamble= "\
 #else\n\
 # define yyprintf(args)\n\
 #endif\n\
+#ifndef YY_LIKELY\n\
+#ifdef __GNUC__\n\
+#define YY_LIKELY(c)	__builtin_expect(!!(c), 1)\n\
+#define YY_UNLIKELY(c)	__builtin_expect(!!(c), 0)\n\
+#define YY_HOT		__attribute__((hot))\n\
+#define YY_COLD		__attribute__((cold))\n\
+#else\n\
+#define YY_LIKELY(c)	(c)\n\
+#define YY_UNLIKELY(c)	(c)\n\
+#define YY_HOT\n\
+#define YY_COLD\n\
+#endif\n\
+#endif\n\
+#ifndef YY_UNUSED\n\
+#ifdef __GNUC__\n\
+#define YY_UNUSED	__attribute__((unused))\n\
+#else\n\
+#define YY_UNUSED\n\
+#endif\n\
+#endif\n\
+#ifndef YY_COLD_LABEL\n\
+#if defined(__GNUC__) && !defined(__clang__)\n\
+#define YY_COLD_LABEL	__attribute__((cold))\n\
+#else\n\
+#define YY_COLD_LABEL\n\
+#endif\n\
+#endif\n\
 #ifndef YYSTYPE\n\
 #define YYSTYPE	int\n\
 #endif\n\
@@ -432,20 +1539,63 @@ static char *preamble= "\
 #ifndef YY_BUFFER_SIZE\n\
 #define YY_BUFFER_SIZE 1024\n\
 #endif\n\
+#ifndef YY_OFFSET\n\
+#define YY_OFFSET int\n\
+#endif\n\
+#ifndef YY_ARENA_SIZE\n\
+#define YY_ARENA_SIZE 4096\n\
+#endif\n\
+#ifndef YY_ARENA_ALIGN\n\
+#define YY_ARENA_ALIGN 16\n\
+#endif\n\
+#ifndef YY_POOL_SIZE\n\
+#define YY_POOL_SIZE 16\n\
+#endif\n\
+#ifndef YY_POOL_TRIM\n\
+#define YY_POOL_TRIM 65536\n\
+#endif\n\
+#ifdef YY_ALLOC\n\
+#define yyalloc(yy, size)	yyAlloc(yy, size)\n\
+#endif\n\
+#ifndef YY_EXPECT_SIZE\n\
+#define YY_EXPECT_SIZE 16\n\
+#endif\n\
+#ifndef YY_LIMIT_INTERVAL\n\
+#define YY_LIMIT_INTERVAL 1024\n\
+#endif\n\
+#ifndef YY_MEMO_THRESHOLD\n\
+#define YY_MEMO_THRESHOLD 3\n\
+#endif\n\
+#ifndef YY_MEMO_VISITS\n\
+#define YY_MEMO_VISITS 1024\n\
+#endif\n\
+#ifndef YY_RULE_COUNT\n\
+#define YY_RULE_COUNT 0\n\
+#endif\n\
 \n\
 #ifndef YY_PART\n\
 \n\
 typedef struct _yycontext yycontext;\n\
-typedef void (*yyaction)(yycontext *yy, int yybegin, int yyend);\n\
-typedef struct _yythunk { int begin, end;  yyaction  action;  struct _yythunk *next; } yythunk;\n\
+typedef void (*yyaction)(yycontext *yy, YY_OFFSET yybegin, YY_OFFSET yyend);\n\
+typedef struct _yythunk { YY_OFFSET begin, end;  yyaction  action;  int frame; } yythunk;\n\
+typedef struct _yynode { int rule;  YY_OFFSET begin, end;  int child, next; } yynode;\n\
+typedef struct _yychunk { struct _yychunk *next;  size_t size; } yychunk;\n\
+typedef struct _yyexpect { int kind, value;  const char *text; } yyexpect;\n\
+typedef struct _yyrecord { const char *text;  YY_OFFSET length;  int ok;  YY_OFFSET end; } yyrecord;\n\
+typedef struct _yymemorule { unsigned gen;  YY_OFFSET far;  int on; } yymemorule;\n\
+typedef struct _yymemovisit { unsigned gen;  int rule;  YY_OFFSET pos;  int count; } yymemovisit;\n\
+typedef struct _yymemo { unsigned gen;  int rule, ok;  YY_OFFSET pos, next, begin, end;  int thunk, thunks; } yymemo;\n\
+typedef struct _yymemomark { int rule;  YY_OFFSET pos;  int thunkpos, frame; } yymemomark;\n\
+enum { YYEXPECT_DOT, YYEXPECT_CHAR, YYEXPECT_STRING, YYEXPECT_CLASS, YYEXPECT_RULE };\n\
+enum { YYLIMIT_STEPS= 1, YYLIMIT_TIME, YYLIMIT_MEMORY };\n\
 \n\
 struct _yycontext {\n\
     char     *__buf;\n\
-    int       __buflen;\n\
-    int       __pos;\n\
-    int       __limit;\n\
-    int       __begin;\n\
-    int       __end;\n\
+    YY_OFFSET __buflen;\n\
+    YY_OFFSET __pos;\n\
+    YY_OFFSET __limit;\n\
+    YY_OFFSET __begin;\n\
+    YY_OFFSET __end;\n\
     yythunk  *__thunks;\n\
     int       __thunkslen;\n\
     int       __thunkpos;\n\
@@ -453,6 +1603,39 @@ struct _yycontext {\n\
     YYSTYPE  *__val;\n\
     YYSTYPE  *__vals;\n\
     int       __valslen;\n\
+    int       __frame;\n\
+    yynode   *__nodes;\n\
+    int       __nodeslen;\n\
+    int       __nodecount;\n\
+    YY_OFFSET __offset;\n\
+    yychunk  *__chunks;\n\
+    char     *__arena;\n\
+    char     *__arenalimit;\n\
+    YY_OFFSET __farthest;\n\
+    int       __expectcount;\n\
+    yyexpect  __expected[YY_EXPECT_SIZE];\n\
+    int     (*__expectfrom)(yycontext *yy);\n\
+    int       __expecting;\n\
+    YY_OFFSET __pending;\n\
+    int       __invalid;\n\
+    int       __borrowed;\n\
+    int       __limited;\n\
+    int       __countdown;\n\
+    unsigned long __steps;\n\
+    unsigned long __maxsteps;\n\
+    long      __maxmillis;\n\
+    long long __deadline;\n\
+    size_t    __maxbytes;\n\
+    yymemorule  *__memorules;\n\
+    yymemovisit *__memovisits;\n\
+    unsigned  __memogen;\n\
+    yymemo   *__memos;\n\
+    int       __memoslen;\n\
+    int       __memocount;\n\
+    int       __memook;\n\
+    yythunk  *__memothunks;\n\
+    int       __memothunkslen;\n\
+    int       __memothunkpos;\n\
 #ifdef YY_CTX_MEMBERS\n\
     YY_CTX_MEMBERS\n\
 #endif\n\
@@ -476,8 +1659,12 @@ struct _yycontext {\n\
 #define YY_CTX_PARAM\n\
 #define YY_CTX_ARG_\n\
 #define YY_CTX_ARG\n\
+#ifdef YY_SPLIT_PART\n\
+    extern yycontext *yyctx;\n\
+#else\n\
     yycontext _yyctx= { 0, 0 };\n\
     yycontext *yyctx= &_yyctx;\n\
+#endif\n\
 #ifndef YY_INPUT\n\
 #define YY_INPUT(buf, result, max_size)			\\\n\
 {							\\\n\
@@ -485,118 +1672,715 @@ struct _yycontext {\n\
     result= (EOF == yyc) ? 0 : (*(buf)= yyc, 1);	\\\n\
     yyprintf((stderr, \"<%c>\", yyc));			\\\n\
 }\n\
-#endif\n\
-#endif\n\
+#endif\n\
+#endif\n\
+\n\
+#ifdef YY_PROFILE\n\
+typedef struct _yycounts { const char *rule;  unsigned long calls, fails;  int choices;  unsigned long *chosen;  struct _yycounts *next; } yycounts;\n\
+#ifdef YY_SPLIT_PART\n\
+    extern yycounts *yycounted;\n\
+#else\n\
+    yycounts *yycounted= 0;\n\
+#endif\n\
+#define YY_PROFILED(name, n)	static unsigned long yychosen[(n) + 1];  static yycounts yycount= { name, 0, 0, n, yychosen, 0 };  if (!yycount.calls++) { yycount.next= yycounted;  yycounted= &yycount; }\n\
+#define YY_FAILED		++yycount.fails\n\
+#define YY_CHOSEN(n)		++yychosen[n]\n\
+#else\n\
+#define YY_PROFILED(name, n)\n\
+#define YY_FAILED\n\
+#define YY_CHOSEN(n)\n\
+#endif\n\
+\n\
+#ifdef YY_LIMITS\n\
+#define YY_LIMITED(yy)		(YY_UNLIKELY(!--(yy)->__countdown) && yyLimited(yy))\n\
+#define YY_AFFORD(yy, size)	yyAfford(yy, size)\n\
+#else\n\
+#define YY_LIMITED(yy)		0\n\
+#define YY_AFFORD(yy, size)	1\n\
+#endif\n\
+\n\
+#ifdef YY_MEMO\n\
+#define YY_MEMO_ENTER(yy, n)	yymemomark yymark;  yymark.rule= 0;  if (YY_LIKELY(yy->__memorules[n].gen == yy->__memogen && yy->__pos > yy->__memorules[n].far && !yy->__memorules[n].on)) yy->__memorules[n].far= yy->__pos;  else if (yyMemoEnter(yy, n, &yymark)) return yy->__memook\n\
+#define YY_MEMO_LEAVE(yy, ok)	if (YY_UNLIKELY(yymark.rule)) yyMemoLeave(yy, &yymark, ok)\n\
+#else\n\
+#define YY_MEMO_ENTER(yy, n)\n\
+#define YY_MEMO_LEAVE(yy, ok)\n\
+#endif\n\
+\n\
+#ifdef YY_VALIDATE_UTF8\n\
+#ifndef YY_INVALID_UTF8\n\
+#define YY_INVALID_UTF8(yy, offset)\n\
+#endif\n\
+\n\
+/* Advance *valid over the complete UTF-8 sequences in the n bytes at\n\
+ * p, and answer 0 if it stopped at an invalid sequence or 1 if at the\n\
+ * end or at a sequence that the end cuts short.  Runs of ASCII are\n\
+ * checked eight bytes at a time.\n\
+ */\n\
+YY_LOCAL(int) yyvalidutf8(const unsigned char *p, YY_OFFSET n, YY_OFFSET *valid)\n\
+{\n\
+    YY_OFFSET i= 0;\n\
+    int ok= 1;\n\
+    while (i < n)\n\
+    {\n\
+        unsigned long long w;\n\
+        int c= p[i], length, lo= 0x80, hi= 0xbf, j;\n\
+        if (c < 0x80)\n\
+        {\n\
+            while (i + 8 <= n && (memcpy(&w, p + i, 8), !(w & 0x8080808080808080ULL))) i += 8;\n\
+            while (i < n && p[i] < 0x80) ++i;\n\
+            continue;\n\
+        }\n\
+        if      (c < 0xc2) { ok= 0;  break; }\n\
+        else if (c < 0xe0) length= 2;\n\
+        else if (c < 0xf0) { length= 3;  if (0xe0 == c) lo= 0xa0;  if (0xed == c) hi= 0x9f; }\n\
+        else if (c < 0xf5) { length= 4;  if (0xf0 == c) lo= 0x90;  if (0xf4 == c) hi= 0x8f; }\n\
+        else { ok= 0;  break; }\n\
+        if (i + 1 < n && (p[i + 1] < lo || p[i + 1] > hi)) { ok= 0;  break; }\n\
+        for (j= 2;  j < length && i + j < n && 0x80 == (p[i + j] & 0xc0);  ++j);\n\
+        if (i + length > n) { ok= i + j >= n;  break; }\n\
+        if (j < length) { ok= 0;  break; }\n\
+        i += length;\n\
+    }\n\
+    *valid += i;\n\
+    return ok;\n\
+}\n\
+#endif\n\
+\n\
+#ifdef YY_LIMITS\n\
+#include <time.h>\n\
+\n\
+YY_LOCAL(long long) yyNow(void)\n\
+{\n\
+    struct timespec yyt;\n\
+    clock_gettime(CLOCK_MONOTONIC, &yyt);\n\
+    return yyt.tv_sec * 1000000000LL + yyt.tv_nsec;\n\
+}\n\
+\n\
+/* Grant yy the rule invocations it may make before the limits are\n\
+ * next checked.\n\
+ */\n\
+YY_LOCAL(void) yyCountdown(yycontext *yy)\n\
+{\n\
+    unsigned long yyleft= yy->__maxsteps ? yy->__maxsteps - yy->__steps : YY_LIMIT_INTERVAL;\n\
+    yy->__countdown= yyleft < YY_LIMIT_INTERVAL ? yyleft : YY_LIMIT_INTERVAL;\n\
+    yy->__steps += yy->__countdown;\n\
+}\n\
+\n\
+/* Answer whether the parse has run out of steps or time.  From then\n\
+ * on every rule fails as soon as it is called, no more input is read,\n\
+ * and the parse fails.\n\
+ */\n\
+YY_LOCAL(int) yyLimited(yycontext *yy)\n\
+{\n\
+    if (!yy->__limited)\n\
+    {\n\
+        if (yy->__maxsteps && yy->__steps >= yy->__maxsteps)\n\
+            yy->__limited= YYLIMIT_STEPS;\n\
+        else if (yy->__deadline && yyNow() >= yy->__deadline)\n\
+            yy->__limited= YYLIMIT_TIME;\n\
+        else\n\
+        {\n\
+            yyCountdown(yy);\n\
+            return 0;\n\
+        }\n\
+    }\n\
+    yy->__countdown= 1;\n\
+    return 1;\n\
+}\n\
+\n\
+/* Answer whether yy can grow by size bytes within its memory limit,\n\
+ * stopping the parse if it cannot.\n\
+ */\n\
+YY_LOCAL(int) yyAfford(yycontext *yy, size_t size)\n\
+{\n\
+    yychunk *yyc;\n\
+    if (!yy->__maxbytes) return 1;\n\
+    size += yy->__buflen + sizeof(yythunk) * yy->__thunkslen + sizeof(YYSTYPE) * yy->__valslen + sizeof(yynode) * yy->__nodeslen;\n\
+    size += sizeof(yymemo) * yy->__memoslen + sizeof(yythunk) * yy->__memothunkslen;\n\
+    for (yyc= yy->__chunks;  yyc;  yyc= yyc->next)\n\
+        size += yyc->size;\n\
+    if (size <= yy->__maxbytes) return 1;\n\
+    yy->__limited= YYLIMIT_MEMORY;\n\
+    yy->__countdown= 1;\n\
+    return 0;\n\
+}\n\
+#endif\n\
+\n\
+/* Read more input after the end of the buffer.  When validating UTF-8,\n\
+ * only complete sequences are added to the buffer; the bytes of one cut\n\
+ * short by the end of the input read so far are kept pending after it.\n\
+ * The first invalid sequence ends the input, and __invalid becomes 1\n\
+ * when it is found and 2 once the parse asks for input beyond it.\n\
+ */\n\
+YY_LOCAL(int) yyrefill(yycontext *yy)\n\
+{\n\
+    YY_OFFSET yyn;\n\
+#ifdef YY_VALIDATE_UTF8\n\
+    YY_OFFSET yylimit= yy->__limit;\n\
+    int       yyok;\n\
+    if (yy->__invalid)\n\
+    {\n\
+        yy->__invalid= 2;\n\
+        return 0;\n\
+    }\n\
+#endif\n\
+    if (yy->__borrowed || yy->__limited) return 0;\n\
+#ifdef YY_VALIDATE_UTF8\n\
+  yyagain:\n\
+#endif\n\
+    while (yy->__buflen - yy->__limit - yy->__pending < 512)\n\
+    {\n\
+        if (!YY_AFFORD(yy, yy->__buflen)) return 0;\n\
+        yy->__buflen *= 2;\n\
+        yy->__buf= (char *)YY_REALLOC(yy, yy->__buf, yy->__buflen);\n\
+    }\n\
+#ifdef YY_CTX_LOCAL\n\
+    YY_INPUT(yy, (yy->__buf + yy->__limit + yy->__pending), yyn, (yy->__buflen - yy->__limit - yy->__pending));\n\
+#else\n\
+    YY_INPUT((yy->__buf + yy->__limit + yy->__pending), yyn, (yy->__buflen - yy->__limit - yy->__pending));\n\
+#endif\n\
+#ifdef YY_VALIDATE_UTF8\n\
+    yy->__pending += yyn;\n\
+    yyok= yyvalidutf8((unsigned char *)yy->__buf + yy->__limit, yy->__pending, &yy->__limit);\n\
+    yy->__pending -= yy->__limit - yylimit;\n\
+    if (!yyok || (!yyn && yy->__pending))\n\
+    {\n\
+        yy->__invalid= 1;\n\
+        yy->__pending= 0;\n\
+        YY_INVALID_UTF8(yy, yy->__offset + yy->__limit);\n\
+    }\n\
+    else if (yyn && yy->__limit == yylimit)\n\
+        goto yyagain;\n\
+    if (yy->__limit > yylimit) return 1;\n\
+    if (yy->__invalid) yy->__invalid= 2;\n\
+    return 0;\n\
+#else\n\
+    if (!yyn) return 0;\n\
+    yy->__limit += yyn;\n\
+    return 1;\n\
+#endif\n\
+}\n\
+\n\
+/* Remember, while yyexpected() runs a failed parse again, that the\n\
+ * parser expected something at the farthest position it had reached.\n\
+ */\n\
+YY_LOCAL(void) yyExpect(yycontext *yy, int kind, int value, const char *text)\n\
+{\n\
+    int i;\n\
+    if (yy->__pos != yy->__farthest) return;\n\
+    for (i= 0;  i < yy->__expectcount;  ++i)\n\
+        if (yy->__expected[i].kind == kind && yy->__expected[i].value == value && yy->__expected[i].text == text)\n\
+            return;\n\
+    if (yy->__expectcount < YY_EXPECT_SIZE)\n\
+    {\n\
+        yy->__expected[yy->__expectcount].kind= kind;\n\
+        yy->__expected[yy->__expectcount].value= value;\n\
+        yy->__expected[yy->__expectcount].text= text;\n\
+        ++yy->__expectcount;\n\
+    }\n\
+}\n\
+\n\
+/* Note how far the parse has got when a match fails.  What was expected\n\
+ * there is found only if yyexpected() asks for it.\n\
+ */\n\
+#define yyexpect(yy, kind, value, text)	(YY_UNLIKELY((yy)->__expecting) ? yyExpect(yy, kind, value, text) : (yy)->__pos > (yy)->__farthest ? (void)((yy)->__farthest= (yy)->__pos) : (void)0)\n\
+\n\
+YY_UNUSED YY_LOCAL(int) yymatchDot(yycontext *yy)\n\
+{\n\
+    if (yy->__pos >= yy->__limit && !yyrefill(yy)) return (yyexpect(yy, YYEXPECT_DOT, 0, 0), 0);\n\
+    ++yy->__pos;\n\
+    return 1;\n\
+}\n\
+\n\
+YY_UNUSED YY_LOCAL(int) yymatchChar(yycontext *yy, int c)\n\
+{\n\
+    if (yy->__pos >= yy->__limit && !yyrefill(yy)) return (yyexpect(yy, YYEXPECT_CHAR, c, 0), 0);\n\
+    if ((unsigned char)yy->__buf[yy->__pos] == c)\n\
+    {\n\
+        ++yy->__pos;\n\
+        yyprintf((stderr, \"  ok   yymatchChar(yy, %c) @ %s\\n\", c, yy->__buf+yy->__pos));\n\
+        return 1;\n\
+    }\n\
+    yyprintf((stderr, \"  fail yymatchChar(yy, %c) @ %s\\n\", c, yy->__buf+yy->__pos));\n\
+    yyexpect(yy, YYEXPECT_CHAR, c, 0);\n\
+    return 0;\n\
+}\n\
+\n\
+YY_UNUSED YY_LOCAL(int) yymatchString(yycontext *yy, const char *s)\n\
+{\n\
+    YY_OFFSET yysav= yy->__pos;\n\
+    const char *yystr= s;\n\
+    while (*s)\n\
+    {\n\
+        if ((yy->__pos >= yy->__limit && !yyrefill(yy)) || yy->__buf[yy->__pos] != *s)\n\
+        {\n\
+            yy->__pos= yysav;\n\
+            yyexpect(yy, YYEXPECT_STRING, 0, yystr);\n\
+            return 0;\n\
+        }\n\
+        ++s;\n\
+        ++yy->__pos;\n\
+    }\n\
+    return 1;\n\
+}\n\
+\n\
+YY_UNUSED YY_LOCAL(int) yymatchClass(yycontext *yy, unsigned char *bits)\n\
+{\n\
+    int c;\n\
+    if (yy->__pos >= yy->__limit && !yyrefill(yy)) return (yyexpect(yy, YYEXPECT_CLASS, 0, (const char *)bits), 0);\n\
+    c= (unsigned char)yy->__buf[yy->__pos];\n\
+    if (bits[c >> 3] & (1 << (c & 7)))\n\
+    {\n\
+        ++yy->__pos;\n\
+        yyprintf((stderr, \"  ok   yymatchClass @ %s\\n\", yy->__buf+yy->__pos));\n\
+        return 1;\n\
+    }\n\
+    yyprintf((stderr, \"  fail yymatchClass @ %s\\n\", yy->__buf+yy->__pos));\n\
+    yyexpect(yy, YYEXPECT_CLASS, 0, (const char *)bits);\n\
+    return 0;\n\
+}\n\
+\n\
+#define yyavail(yy, p)		((p) < (yy)->__limit || yyrefill(yy))\n\
+#define yyinclass(bits, c)	((bits)[(unsigned char)(c) >> 3] & (1 << ((unsigned char)(c) & 7)))\n\
+\n\
+YY_LOCAL(int) yyescape(char *out, int c)\n\
+{\n\
+    if (c >= ' ' && c <= '~' && c != '\\\\' && c != '\\'' && c != '\"' && c != ']')\n\
+        return (*out= c), 1;\n\
+    switch (c)\n\
+    {\n\
+        case '\\n':	return sprintf(out, \"\\\\n\");\n\
+        case '\\r':	return sprintf(out, \"\\\\r\");\n\
+        case '\\t':	return sprintf(out, \"\\\\t\");\n\
+    }\n\
+    return sprintf(out, \"\\\\%03o\", c);\n\
+}\n\
+\n\
+/* Describe what the parser expected at the farthest failure. */\n\
+YY_LOCAL(int) yyformatExpected(yycontext *yy, char *buf, int size)\n\
+{\n\
+    char text[1100];\n\
+    int  i, c, n= 0;\n\
+    if (size > 0) *buf= 0;\n\
+    for (i= 0;  i < yy->__expectcount;  ++i)\n\
+    {\n\
+        yyexpect   *e= yy->__expected + i;\n\
+        char	   *t= text;\n\
+        const char *s;\n\
+        switch (e->kind)\n\
+        {\n\
+            case YYEXPECT_DOT:		strcpy(t, \"any character\");  break;\n\
+            case YYEXPECT_RULE:		snprintf(t, 1024, \"%s\", e->text);  break;\n\
+            case YYEXPECT_CHAR:		*t++= '\\'';  t += yyescape(t, e->value);  *t++= '\\'';  *t= 0;  break;\n\
+            case YYEXPECT_STRING:\n\
+                *t++= '\"';\n\
+                for (s= e->text;  *s && t < text + 1024;  ++s) t += yyescape(t, (unsigned char)*s);\n\
+                *t++= '\"';  *t= 0;\n\
+                break;\n\
+            case YYEXPECT_CLASS:\n\
+                *t++= '[';\n\
+                for (c= 0;  c < 256;  ++c)\n\
+                    if (yyinclass((unsigned char *)e->text, c))\n\
+                    {\n\
+                        int d= c;\n\
+                        while (d < 255 && yyinclass((unsigned char *)e->text, d + 1)) ++d;\n\
+                        t += yyescape(t, c);\n\
+                        if (d > c) *t++= '-', t += yyescape(t, d);\n\
+                        c= d;\n\
+                    }\n\
+                *t++= ']';  *t= 0;\n\
+                break;\n\
+        }\n\
+        if (n < size) n += snprintf(buf + n, size - n, \"%s%s\", i ? \", \" : \"\", text);\n\
+    }\n\
+    return yy->__expectcount;\n\
+}\n\
+\n\
+YY_UNUSED YY_LOCAL(int) yyscanString(yycontext *yy, YY_OFFSET p, const char *s)\n\
+{\n\
+    int yyn;\n\
+    for (yyn= 0;  s[yyn];  ++yyn)\n\
+        if (!yyavail(yy, p + yyn) || yy->__buf[p + yyn] != s[yyn]) return -1;\n\
+    return yyn;\n\
+}\n\
+\n\
+#ifdef YY_CASELESS\n\
+/* Compare n bytes at p with the lower-case string s, ignoring case\n\
+ * wherever the mask m has the bit 0x20 set (that is, at ASCII letters).\n\
+ * Eight bytes are compared at a time; the final word overlaps the one\n\
+ * before it rather than falling back to single bytes.\n\
+ */\n\
+YY_LOCAL(int) yyfold(const char *p, const char *s, const char *m, int n)\n\
+{\n\
+    unsigned long long a, b, c;\n\
+    unsigned int       x, y, z;\n\
+    int                i;\n\
+    if (n >= 8)\n\
+    {\n\
+        for (i= 0;  i + 8 < n;  i += 8)\n\
+        {\n\
+            memcpy(&a, p + i, 8);  memcpy(&b, s + i, 8);  memcpy(&c, m + i, 8);\n\
+            if ((a | c) != b) return 0;\n\
+        }\n\
+        memcpy(&a, p + n - 8, 8);  memcpy(&b, s + n - 8, 8);  memcpy(&c, m + n - 8, 8);\n\
+        return (a | c) == b;\n\
+    }\n\
+    if (n >= 4)\n\
+    {\n\
+        memcpy(&x, p, 4);  memcpy(&y, s, 4);  memcpy(&z, m, 4);\n\
+        if ((x | z) != y) return 0;\n\
+        memcpy(&x, p + n - 4, 4);  memcpy(&y, s + n - 4, 4);  memcpy(&z, m + n - 4, 4);\n\
+        return (x | z) == y;\n\
+    }\n\
+    for (i= 0;  i < n;  ++i)\n\
+        if ((p[i] | m[i]) != s[i]) return 0;\n\
+    return 1;\n\
+}\n\
+\n\
+YY_UNUSED YY_LOCAL(int) yymatchCaseless(yycontext *yy, const char *s, const char *m, int n)\n\
+{\n\
+    while (yy->__limit - yy->__pos < n)\n\
+        if (!yyrefill(yy)) return (yyexpect(yy, YYEXPECT_STRING, 0, s), 0);\n\
+    if ((yy->__buf[yy->__pos] | *m) == *s && yyfold(yy->__buf + yy->__pos, s, m, n))\n\
+    {\n\
+        yy->__pos += n;\n\
+        yyprintf((stderr, \"  ok   yymatchCaseless(yy, %s) @ %s\\n\", s, yy->__buf+yy->__pos));\n\
+        return 1;\n\
+    }\n\
+    yyprintf((stderr, \"  fail yymatchCaseless(yy, %s) @ %s\\n\", s, yy->__buf+yy->__pos));\n\
+    yyexpect(yy, YYEXPECT_STRING, 0, s);\n\
+    return 0;\n\
+}\n\
+\n\
+YY_UNUSED YY_LOCAL(int) yyscanCaseless(yycontext *yy, YY_OFFSET p, const char *s, const char *m, int n)\n\
+{\n\
+    while (yy->__limit - p < n)\n\
+        if (!yyrefill(yy)) return -1;\n\
+    return yyfold(yy->__buf + p, s, m, n) ? n : -1;\n\
+}\n\
+#endif\n\
+\n\
+YY_UNUSED YY_LOCAL(void) yyDo(yycontext *yy, yyaction action, YY_OFFSET begin, YY_OFFSET end)\n\
+{\n\
+    while (yy->__thunkpos >= yy->__thunkslen)\n\
+    {\n\
+        if (!YY_AFFORD(yy, sizeof(yythunk) * yy->__thunkslen)) return;	/* the parse will fail */\n\
+        yy->__thunkslen *= 2;\n\
+        yy->__thunks= (yythunk *)YY_REALLOC(yy, yy->__thunks, sizeof(yythunk) * yy->__thunkslen);\n\
+    }\n\
+    yy->__thunks[yy->__thunkpos].begin=  begin;\n\
+    yy->__thunks[yy->__thunkpos].end=    end;\n\
+    yy->__thunks[yy->__thunkpos].action= action;\n\
+    yy->__thunks[yy->__thunkpos].frame=  yy->__frame;\n\
+    ++yy->__thunkpos;\n\
+}\n\
+\n\
+#ifdef YY_MEMO\n\
+/* A rule is called again at a position where it was called before only\n\
+ * when the parser has backtracked.  Calls before the farthest position\n\
+ * at which a rule was called are therefore counted, per position, and\n\
+ * once a rule has been called more than YY_MEMO_THRESHOLD times at one\n\
+ * position its results are remembered for the rest of the parse.  A\n\
+ * call at a remembered position then answers at once.  The thunks that\n\
+ * a successful call records are moved into __memothunks and replaced by\n\
+ * one thunk that runs them, which is all a later call needs to record,\n\
+ * so that the work stays proportional to the input.  Counts are kept\n\
+ * in a small table indexed by a hash, so collisions can only delay\n\
+ * memoization.  Every entry belongs to the parse whose generation\n\
+ * __memogen it records; entries from earlier parses count as empty, so\n\
+ * that starting a parse forgets everything in constant time.\n\
+ */\n\
+#define yyMemoHash(rule, pos)	((unsigned)(pos) * 2654435761u ^ (unsigned)(rule) * 40503u)\n\
+\n\
+YY_LOCAL(void) yyMemoRun(yycontext *yy, YY_OFFSET thunk, YY_OFFSET count)\n\
+{\n\
+    YYSTYPE *val= yy->__val;\n\
+    yythunk *t;\n\
+    for (t= yy->__memothunks + thunk;  count--;  ++t)\n\
+    {\n\
+        yy->__val= val + t->frame;\n\
+        t->action(yy, t->begin, t->end);\n\
+    }\n\
+}\n\
+\n\
+YY_LOCAL(yymemo *) yyMemoFind(yycontext *yy, int rule, YY_OFFSET pos)\n\
+{\n\
+    unsigned mask= yy->__memoslen - 1, i= yyMemoHash(rule, pos) & mask;\n\
+    while (yy->__memos[i].gen == yy->__memogen && (yy->__memos[i].rule != rule || yy->__memos[i].pos != pos))\n\
+        i= (i + 1) & mask;\n\
+    return yy->__memos + i;\n\
+}\n\
+\n\
+YY_LOCAL(int) yyMemoGrow(yycontext *yy)\n\
+{\n\
+    yymemo *memos= yy->__memos;\n\
+    int     length= yy->__memoslen, i;\n\
+    if (!YY_AFFORD(yy, sizeof(yymemo) * (length ? length * 2 : 256))) return 0;\n\
+    yy->__memoslen= length ? length * 2 : 256;\n\
+    yy->__memos= (yymemo *)YY_MALLOC(yy, sizeof(yymemo) * yy->__memoslen);\n\
+    memset(yy->__memos, 0, sizeof(yymemo) * yy->__memoslen);\n\
+    for (i= 0;  i < length;  ++i)\n\
+        if (memos[i].gen == yy->__memogen)\n\
+            *yyMemoFind(yy, memos[i].rule, memos[i].pos)= memos[i];\n\
+    if (memos) YY_FREE(memos);\n\
+    return 1;\n\
+}\n\
+\n\
+/* Answer 1 if the result of rule at the current position is known,\n\
+ * having replayed it and set __memook, and otherwise 0, after setting\n\
+ * mark if the result is to be remembered when the rule returns.\n\
+ */\n\
+YY_LOCAL(int) yyMemoEnter(yycontext *yy, int rule, yymemomark *mark)\n\
+{\n\
+    yymemorule *r= yy->__memorules + rule;\n\
+    yymemo     *m;\n\
+    if (r->gen != yy->__memogen)\n\
+    {\n\
+        r->gen= yy->__memogen;\n\
+        r->far= yy->__pos;\n\
+        r->on= 0;\n\
+        return 0;\n\
+    }\n\
+    if (yy->__pos > r->far)\n\
+        r->far= yy->__pos;\n\
+    else if (!r->on)\n\
+    {\n\
+        yymemovisit *v;\n\
+        if (!yy->__memovisits)\n\
+        {\n\
+            yy->__memovisits= (yymemovisit *)YY_MALLOC(yy, sizeof(yymemovisit) * YY_MEMO_VISITS);\n\
+            memset(yy->__memovisits, 0, sizeof(yymemovisit) * YY_MEMO_VISITS);\n\
+        }\n\
+        v= yy->__memovisits + (yyMemoHash(rule, yy->__pos) & (YY_MEMO_VISITS - 1));\n\
+        if (v->gen != yy->__memogen || v->rule != rule || v->pos != yy->__pos)\n\
+        {\n\
+            v->gen= yy->__memogen;\n\
+            v->rule= rule;\n\
+            v->pos= yy->__pos;\n\
+            v->count= 0;\n\
+        }\n\
+        if (++v->count <= YY_MEMO_THRESHOLD) return 0;\n\
+        r->on= 1;\n\
+    }\n\
+    if (!r->on) return 0;\n\
+    if (yy->__memocount && (m= yyMemoFind(yy, rule, yy->__pos))->gen == yy->__memogen)\n\
+    {\n\
+        if ((yy->__memook= m->ok))\n\
+        {\n\
+            if (m->thunks) yyDo(yy, yyMemoRun, m->thunk, m->thunks);\n\
+            yy->__pos= m->next;\n\
+            yy->__begin= m->begin;\n\
+            yy->__end= m->end;\n\
+        }\n\
+        return 1;\n\
+    }\n\
+    mark->rule= rule;\n\
+    mark->pos= yy->__pos;\n\
+    mark->thunkpos= yy->__thunkpos;\n\
+    mark->frame= yy->__frame;\n\
+    return 0;\n\
+}\n\
+\n\
+/* Remember the result of the call marked by mark, if there is room. */\n\
+YY_LOCAL(void) yyMemoLeave(yycontext *yy, yymemomark *mark, int ok)\n\
+{\n\
+    int     count= ok ? yy->__thunkpos - mark->thunkpos : 0, length, i;\n\
+    yymemo *m;\n\
+    if (yy->__limited) return;\n\
+    if (2 * (yy->__memocount + 1) > yy->__memoslen && !yyMemoGrow(yy)) return;\n\
+    if (yy->__memothunkpos + count > yy->__memothunkslen)\n\
+    {\n\
+        length= yy->__memothunkslen ? yy->__memothunkslen : YY_STACK_SIZE;\n\
+        while (length < yy->__memothunkpos + count) length *= 2;\n\
+        if (!YY_AFFORD(yy, sizeof(yythunk) * (length - yy->__memothunkslen))) return;\n\
+        yy->__memothunkslen= length;\n\
+        yy->__memothunks= (yythunk *)YY_REALLOC(yy, yy->__memothunks, sizeof(yythunk) * length);\n\
+    }\n\
+    m= yyMemoFind(yy, mark->rule, mark->pos);\n\
+    m->gen= yy->__memogen;\n\
+    m->rule= mark->rule;\n\
+    m->pos= mark->pos;\n\
+    m->ok= ok;\n\
+    m->next= yy->__pos;\n\
+    m->begin= yy->__begin;\n\
+    m->end= yy->__end;\n\
+    m->thunk= yy->__memothunkpos;\n\
+    m->thunks= count;\n\
+    for (i= 0;  i < count;  ++i)\n\
+    {\n\
+        yythunk *t= yy->__memothunks + yy->__memothunkpos++;\n\
+        *t= yy->__thunks[mark->thunkpos + i];\n\
+        t->frame -= mark->frame;\n\
+    }\n\
+    ++yy->__memocount;\n\
+    if (count)\n\
+    {\n\
+        yy->__thunkpos= mark->thunkpos;\n\
+        yyDo(yy, yyMemoRun, m->thunk, count);\n\
+    }\n\
+}\n\
+\n\
+/* Forget what was remembered by the last parse, by starting a new\n\
+ * generation.  The tables are cleared only when the generation wraps.\n\
+ */\n\
+YY_LOCAL(void) yyMemoReset(yycontext *yy)\n\
+{\n\
+    if (!yy->__memorules)\n\
+    {\n\
+        yy->__memorules= (yymemorule *)YY_MALLOC(yy, sizeof(yymemorule) * (YY_RULE_COUNT + 1));\n\
+        memset(yy->__memorules, 0, sizeof(yymemorule) * (YY_RULE_COUNT + 1));\n\
+    }\n\
+    if (!++yy->__memogen)\n\
+    {\n\
+        memset(yy->__memorules, 0, sizeof(yymemorule) * (YY_RULE_COUNT + 1));\n\
+        if (yy->__memovisits) memset(yy->__memovisits, 0, sizeof(yymemovisit) * YY_MEMO_VISITS);\n\
+        if (yy->__memos) memset(yy->__memos, 0, sizeof(yymemo) * yy->__memoslen);\n\
+        yy->__memogen= 1;\n\
+    }\n\
+    yy->__memocount= 0;\n\
+    yy->__memothunkpos= 0;\n\
+}\n\
+#endif\n\
+\n\
+YY_LOCAL(void) yyDone(yycontext *yy)\n\
+{\n\
+    int pos;\n\
+    for (pos= 0;  pos < yy->__thunkpos;  ++pos)\n\
+    {\n\
+        yythunk *thunk= &yy->__thunks[pos];\n\
+        yyprintf((stderr, \"DO [%d] %p\\n\", pos, thunk->action));\n\
+        yy->__val= yy->__vals + thunk->frame;\n\
+        thunk->action(yy, thunk->begin, thunk->end);\n\
+    }\n\
+    yy->__thunkpos= 0;\n\
+}\n\
 \n\
-YY_LOCAL(int) yyrefill(yycontext *yy)\n\
+/* Push count values for the variables of a rule, answering 0 (and\n\
+ * pushing nothing) if the stack cannot grow within the memory limit.\n\
+ */\n\
+YY_UNUSED YY_LOCAL(int) yyFrame(yycontext *yy, int count)\n\
 {\n\
-    int yyn;\n\
-    while (yy->__buflen - yy->__pos < 512)\n\
+    while (yy->__valslen <= yy->__frame + count)\n\
     {\n\
-        yy->__buflen *= 2;\n\
-        yy->__buf= (char *)YY_REALLOC(yy, yy->__buf, yy->__buflen);\n\
+        if (!YY_AFFORD(yy, sizeof(YYSTYPE) * yy->__valslen)) return 0;\n\
+        yy->__valslen *= 2;\n\
+        yy->__vals= (YYSTYPE *)YY_REALLOC(yy, yy->__vals, sizeof(YYSTYPE) * yy->__valslen);\n\
     }\n\
-#ifdef YY_CTX_LOCAL\n\
-    YY_INPUT(yy, (yy->__buf + yy->__pos), yyn, (yy->__buflen - yy->__pos));\n\
-#else\n\
-    YY_INPUT((yy->__buf + yy->__pos), yyn, (yy->__buflen - yy->__pos));\n\
-#endif\n\
-    if (!yyn) return 0;\n\
-    yy->__limit += yyn;\n\
+    yy->__frame += count;\n\
     return 1;\n\
 }\n\
 \n\
-YY_LOCAL(int) yymatchDot(yycontext *yy)\n\
+#define YY_ARENA_ROUND(N)	(((N) + YY_ARENA_ALIGN - 1) & ~(size_t)(YY_ARENA_ALIGN - 1))\n\
+\n\
+#ifdef YY_ALLOC\n\
+YY_LOCAL(void *) yyArenaGrow(yycontext *yy, size_t size)\n\
 {\n\
-    if (yy->__pos >= yy->__limit && !yyrefill(yy)) return 0;\n\
-    ++yy->__pos;\n\
-    return 1;\n\
+    size_t   header= YY_ARENA_ROUND(sizeof(yychunk));\n\
+    size_t   length= yy->__chunks ? yy->__chunks->size * 2 : YY_ARENA_SIZE;\n\
+    yychunk *chunk;\n\
+    while (length < size) length *= 2;\n\
+    if (!YY_AFFORD(yy, length)) return 0;\n\
+    chunk= (yychunk *)YY_MALLOC(yy, header + length);\n\
+    chunk->next= yy->__chunks;\n\
+    chunk->size= length;\n\
+    yy->__chunks= chunk;\n\
+    yy->__arena= (char *)chunk + header + size;\n\
+    yy->__arenalimit= (char *)chunk + header + length;\n\
+    return (char *)chunk + header;\n\
 }\n\
 \n\
-YY_LOCAL(int) yymatchChar(yycontext *yy, int c)\n\
+/* Answer size bytes from the arena, or 0 if it cannot grow within the\n\
+ * memory limit.\n\
+ */\n\
+YY_UNUSED YY_LOCAL(void *) yyAlloc(yycontext *yy, size_t size)\n\
 {\n\
-    if (yy->__pos >= yy->__limit && !yyrefill(yy)) return 0;\n\
-    if ((unsigned char)yy->__buf[yy->__pos] == c)\n\
-    {\n\
-        ++yy->__pos;\n\
-        yyprintf((stderr, \"  ok   yymatchChar(yy, %c) @ %s\\n\", c, yy->__buf+yy->__pos));\n\
-        return 1;\n\
-    }\n\
-    yyprintf((stderr, \"  fail yymatchChar(yy, %c) @ %s\\n\", c, yy->__buf+yy->__pos));\n\
-    return 0;\n\
+    size= YY_ARENA_ROUND(size);\n\
+    if (size > (size_t)(yy->__arenalimit - yy->__arena)) return yyArenaGrow(yy, size);\n\
+    yy->__arena += size;\n\
+    return yy->__arena - size;\n\
 }\n\
+#endif\n\
 \n\
-YY_LOCAL(int) yymatchString(yycontext *yy, const char *s)\n\
+/* Forget everything allocated so far, keeping only the largest chunk. */\n\
+YY_LOCAL(void) yyArenaReset(yycontext *yy, int keep)\n\
 {\n\
-    int yysav= yy->__pos;\n\
-    while (*s)\n\
+    yychunk *chunk= yy->__chunks, *next;\n\
+    if (!chunk) return;\n\
+    for (next= chunk->next;  next;  next= chunk->next)\n\
     {\n\
-        if (yy->__pos >= yy->__limit && !yyrefill(yy)) return 0;\n\
-        if (yy->__buf[yy->__pos] != *s)\n\
-        {\n\
-            yy->__pos= yysav;\n\
-            return 0;\n\
-        }\n\
-        ++s;\n\
-        ++yy->__pos;\n\
+        chunk->next= next->next;\n\
+        YY_FREE(next);\n\
     }\n\
-    return 1;\n\
+    if (!keep)\n\
+    {\n\
+        YY_FREE(chunk);\n\
+        yy->__chunks= 0;\n\
+        yy->__arena= yy->__arenalimit= 0;\n\
+        return;\n\
+    }\n\
+    yy->__arena= (char *)chunk + YY_ARENA_ROUND(sizeof(yychunk));\n\
 }\n\
 \n\
-YY_LOCAL(int) yymatchClass(yycontext *yy, unsigned char *bits)\n\
+#ifdef YY_TREE\n\
+/* Open a node for rule at the current position and answer its index,\n\
+ * or -1 if the tree cannot grow within the memory limit.\n\
+ */\n\
+YY_LOCAL(int) yyNodeOpen(yycontext *yy, int rule)\n\
 {\n\
-    int c;\n\
-    if (yy->__pos >= yy->__limit && !yyrefill(yy)) return 0;\n\
-    c= (unsigned char)yy->__buf[yy->__pos];\n\
-    if (bits[c >> 3] & (1 << (c & 7)))\n\
+    yynode *node;\n\
+    if (yy->__nodecount == yy->__nodeslen)\n\
     {\n\
-        ++yy->__pos;\n\
-        yyprintf((stderr, \"  ok   yymatchClass @ %s\\n\", yy->__buf+yy->__pos));\n\
-        return 1;\n\
+        if (!YY_AFFORD(yy, sizeof(yynode) * (yy->__nodeslen ? yy->__nodeslen : YY_STACK_SIZE))) return -1;\n\
+        yy->__nodeslen= yy->__nodeslen ? yy->__nodeslen * 2 : YY_STACK_SIZE;\n\
+        yy->__nodes= (yynode *)YY_REALLOC(yy, yy->__nodes, sizeof(yynode) * yy->__nodeslen);\n\
     }\n\
-    yyprintf((stderr, \"  fail yymatchClass @ %s\\n\", yy->__buf+yy->__pos));\n\
-    return 0;\n\
+    node= yy->__nodes + yy->__nodecount;\n\
+    node->rule= rule;\n\
+    node->begin= yy->__offset + yy->__pos;\n\
+    node->child= -1;\n\
+    return yy->__nodecount++;\n\
 }\n\
 \n\
-YY_LOCAL(void) yyDo(yycontext *yy, yyaction action, int begin, int end)\n\
+YY_LOCAL(void) yyNodeClose(yycontext *yy, int index)\n\
 {\n\
-    while (yy->__thunkpos >= yy->__thunkslen)\n\
+    yynode *nodes= yy->__nodes;\n\
+    int     child= index + 1;\n\
+    nodes[index].end= yy->__offset + yy->__pos;\n\
+    nodes[index].next= index ? yy->__nodecount : -1;	/* until the parent closes */\n\
+    if (child < yy->__nodecount)\n\
     {\n\
-        yy->__thunkslen *= 2;\n\
-        yy->__thunks= (yythunk *)YY_REALLOC(yy, yy->__thunks, sizeof(yythunk) * yy->__thunkslen);\n\
+        nodes[index].child= child;\n\
+        while (nodes[child].next < yy->__nodecount) child= nodes[child].next;\n\
+        nodes[child].next= -1;\n\
     }\n\
-    yy->__thunks[yy->__thunkpos].begin=  begin;\n\
-    yy->__thunks[yy->__thunkpos].end=    end;\n\
-    yy->__thunks[yy->__thunkpos].action= action;\n\
-    ++yy->__thunkpos;\n\
 }\n\
 \n\
-YY_LOCAL(void) yyDone(yycontext *yy)\n\
+YY_UNUSED YY_LOCAL(void) yyNodeLeaf(yycontext *yy, int rule, YY_OFFSET length)\n\
 {\n\
-    int pos;\n\
-    for (pos= 0;  pos < yy->__thunkpos;  ++pos)\n\
-    {\n\
-        yythunk *thunk= &yy->__thunks[pos];\n\
-        yyprintf((stderr, \"DO [%d] %p\\n\", pos, thunk->action));\n\
-        thunk->action(yy, thunk->begin, thunk->end);\n\
-    }\n\
-    yy->__thunkpos= 0;\n\
+    int index= yyNodeOpen(yy, rule);\n\
+    if (index < 0) return;	/* the parse will fail */\n\
+    yy->__nodes[index].begin -= length;\n\
+    yyNodeClose(yy, index);\n\
 }\n\
+#endif\n\
 \n\
 YY_LOCAL(void) yyCommit(yycontext *yy)\n\
 {\n\
-    if ((yy->__limit -= yy->__pos))\n\
+    if ((yy->__limit -= yy->__pos) || yy->__pending)\n\
     {\n\
-        memmove(yy->__buf, yy->__buf + yy->__pos, yy->__limit);\n\
+        memmove(yy->__buf, yy->__buf + yy->__pos, yy->__limit + yy->__pending);\n\
     }\n\
     yy->__begin -= yy->__pos;\n\
     yy->__end -= yy->__pos;\n\
+    yy->__offset += yy->__pos;\n\
+    yy->__farthest -= yy->__pos;\n\
     yy->__pos= yy->__thunkpos= 0;\n\
 }\n\
 #ifdef ONE_LANG_REMOVE_COMPILE_ERROR\n\
 #else\n\
 \n\
-YY_LOCAL(int) yyAccept(yycontext *yy, int tp0)\n\
+YY_UNUSED YY_LOCAL(int) yyAccept(yycontext *yy, int tp0)\n\
 {\n\
     if (tp0)\n\
     {\n\
@@ -611,19 +2395,7 @@ YY_LOCAL(int) yyAccept(yycontext *yy, int tp0)\n\
     return 1;\n\
 }\n\
 \n\
-YY_LOCAL(void) yyPush(yycontext *yy, char *text, int count)\n\
-{\n\
-    yy->__val += count;\n\
-    while (yy->__valslen <= yy->__val - yy->__vals)\n\
-    {\n\
-        long offset= yy->__val - yy->__vals;\n\
-        yy->__valslen *= 2;\n\
-        yy->__vals= (YYSTYPE *)YY_REALLOC(yy, yy->__vals, sizeof(YYSTYPE) * yy->__valslen);\n\
-        yy->__val= yy->__vals + offset;\n\
-    }\n\
-}\n\
-YY_LOCAL(void) yyPop(yycontext *yy, char *text, int count)   { yy->__val -= count; }\n\
-YY_LOCAL(void) yySet(yycontext *yy, char *text, int count)   { yy->__val[count]= yy->__; }\n\
+YY_UNUSED YY_LOCAL(void) yySet(yycontext *yy, YY_OFFSET begin, YY_OFFSET end)   { yy->__val[begin]= yy->__; }\n\
 #endif\n\
 \n\
 #endif /* YY_PART */\n\
@@ -638,33 +2410,159 @@ static char *footer = "\n\
 \n\
 typedef int (*yyrule)(yycontext *yy);\n\
 \n\
+/* Prepare yy for a parse starting at the current position. */\n\
+YY_LOCAL(void) yyStart(yycontext *yy)\n\
+{\n\
+    if (!yy->__buflen)\n\
+    {\n\
+        yy->__buflen= YY_BUFFER_SIZE;\n\
+        yy->__buf= (char *)YY_MALLOC(yy, yy->__buflen);\n\
+        yy->__thunkslen= YY_STACK_SIZE;\n\
+        yy->__thunks= (yythunk *)YY_MALLOC(yy, sizeof(yythunk) * yy->__thunkslen);\n\
+        yy->__valslen= YY_STACK_SIZE;\n\
+        yy->__vals= (YYSTYPE *)YY_MALLOC(yy, sizeof(YYSTYPE) * yy->__valslen);\n\
+        yy->__begin= yy->__end= yy->__pos= yy->__limit= yy->__thunkpos= 0;\n\
+    }\n\
+    yy->__begin= yy->__end= yy->__pos;\n\
+    yy->__thunkpos= 0;\n\
+    yy->__val= yy->__vals;\n\
+    yy->__frame= 0;\n\
+    yy->__nodecount= 0;\n\
+    yy->__farthest= yy->__pos;\n\
+    yy->__expectcount= 0;\n\
+    yyArenaReset(yy, 1);\n\
+    yy->__limited= 0;\n\
+    if (yy->__invalid) yy->__invalid= 1;\n\
+#ifdef YY_MEMO\n\
+    yyMemoReset(yy);\n\
+#endif\n\
+#ifdef YY_LIMITS\n\
+    yy->__steps= 0;\n\
+    yyCountdown(yy);\n\
+    yy->__deadline= yy->__maxmillis ? yyNow() + yy->__maxmillis * 1000000LL : 0;\n\
+#endif\n\
+}\n\
+\n\
 YY_PARSE(int) YYPARSEFROM(YY_CTX_PARAM_ yyrule yystart)\n\
 {\n\
     int yyok;\n\
-    if (!yyctx->__buflen)\n\
-    {\n\
-        yyctx->__buflen= YY_BUFFER_SIZE;\n\
-        yyctx->__buf= (char *)YY_MALLOC(yyctx, yyctx->__buflen);\n\
-        yyctx->__thunkslen= YY_STACK_SIZE;\n\
-        yyctx->__thunks= (yythunk *)YY_MALLOC(yyctx, sizeof(yythunk) * yyctx->__thunkslen);\n\
-        yyctx->__valslen= YY_STACK_SIZE;\n\
-        yyctx->__vals= (YYSTYPE *)YY_MALLOC(yyctx, sizeof(YYSTYPE) * yyctx->__valslen);\n\
-        yyctx->__begin= yyctx->__end= yyctx->__pos= yyctx->__limit= yyctx->__thunkpos= 0;\n\
-    }\n\
-    yyctx->__begin= yyctx->__end= yyctx->__pos;\n\
-    yyctx->__thunkpos= 0;\n\
-    yyctx->__val= yyctx->__vals;\n\
-    yyok= yystart(yyctx);\n\
+    yyStart(yyctx);\n\
+    yyok= yystart(yyctx) && !yyctx->__limited && yyctx->__invalid < 2;\n\
     if (yyok) yyDone(yyctx);\n\
+    yyctx->__expectfrom= (yyok || yyctx->__pos) ? 0 : yystart;\n\
     yyCommit(yyctx);\n\
     return yyok;\n\
 }\n\
 \n\
+/* Parse each of count records in place, without copying its text and\n\
+ * without reading input, setting its ok and the offset of the end of\n\
+ * the match.  Text passed to actions points into the record.  Answer\n\
+ * the number of records that matched.  Input read before and not yet\n\
+ * consumed is kept for the next call of yyparse().\n\
+ */\n\
+YY_PARSE(int) YYPARSEBATCH(YY_CTX_PARAM_ yyrule yystart, yyrecord *yyrecords, int yycount)\n\
+{\n\
+    char     *yybuf;\n\
+    YY_OFFSET yylimit, yyoffset, yypos;\n\
+    int       yyi, yyinvalid0, yymatched= 0;\n\
+    yyStart(yyctx);\n\
+    yyinvalid0= yyctx->__invalid;\n\
+    yybuf= yyctx->__buf;\n\
+    yylimit= yyctx->__limit;\n\
+    yyoffset= yyctx->__offset;\n\
+    yypos= yyctx->__pos;\n\
+    yyctx->__borrowed= 1;\n\
+    for (yyi= 0;  yyi < yycount;  ++yyi)\n\
+    {\n\
+        yyrecord *yyr= &yyrecords[yyi];\n\
+        yyctx->__buf= (char *)yyr->text;\n\
+        yyctx->__limit= yyr->length;\n\
+#ifdef YY_VALIDATE_UTF8\n\
+        yyctx->__limit= 0;\n\
+        yyvalidutf8((const unsigned char *)yyr->text, yyr->length, &yyctx->__limit);\n\
+        yyctx->__invalid= yyctx->__limit < yyr->length;\n\
+#endif\n\
+        yyctx->__pos= yyctx->__offset= 0;\n\
+        yyStart(yyctx);\n\
+        if ((yyr->ok= yystart(yyctx) && !yyctx->__limited && yyctx->__invalid < 2))\n\
+        {\n\
+            yyDone(yyctx);\n\
+            ++yymatched;\n\
+        }\n\
+        yyr->end= yyctx->__pos;\n\
+    }\n\
+    yyctx->__borrowed= 0;\n\
+    yyctx->__buf= yybuf;\n\
+    yyctx->__limit= yylimit;\n\
+    yyctx->__offset= yyoffset;\n\
+    yyctx->__pos= yypos;\n\
+    yyStart(yyctx);\n\
+    yyctx->__invalid= yyinvalid0;\n\
+    yyctx->__expectfrom= 0;\n\
+    return yymatched;\n\
+}\n\
+\n\
+\n\
 YY_PARSE(int) YYPARSE(YY_CTX_PARAM)\n\
 {\n\
     return YYPARSEFROM(YY_CTX_ARG_ yy_%s);\n\
 }\n\
 \n\
+/* Find what the last parse expected at the farthest position it reached\n\
+ * by running it again, recording the failures there.  Only a parse that\n\
+ * failed without consuming input can be run again, since its text is\n\
+ * still in the buffer.  Actions are neither run nor kept.\n\
+ */\n\
+YY_LOCAL(void) yyExpectAgain(yycontext *yy)\n\
+{\n\
+    yyrule    yystart= yy->__expectfrom;\n\
+    YY_OFFSET yyfarthest= yy->__farthest;\n\
+    int       yylimited= yy->__limited, yyinvalid= yy->__invalid;\n\
+    yy->__expectfrom= 0;\n\
+    yyStart(yy);\n\
+    yy->__farthest= yyfarthest;\n\
+    yy->__expecting= 1;\n\
+    yystart(yy);\n\
+    yy->__expecting= 0;\n\
+    yy->__pos= yy->__thunkpos= 0;\n\
+    yy->__limited= yylimited;\n\
+    yy->__invalid= yyinvalid;\n\
+}\n\
+\n\
+YY_PARSE(int) YYEXPECTED(YY_CTX_PARAM_ char *yybuf, int yysize)\n\
+{\n\
+    if (yyctx->__expectfrom) yyExpectAgain(yyctx);\n\
+    return yyformatExpected(yyctx, yybuf, yysize);\n\
+}\n\
+\n\
+#ifdef YY_LIMITS\n\
+/* Limit each parse to steps rule invocations, millis milliseconds and\n\
+ * bytes of storage, where zero means no limit.\n\
+ */\n\
+YY_PARSE(void) YYLIMIT(YY_CTX_PARAM_ unsigned long yysteps, long yymillis, size_t yybytes)\n\
+{\n\
+    yyctx->__maxsteps= yysteps;\n\
+    yyctx->__maxmillis= yymillis;\n\
+    yyctx->__maxbytes= yybytes;\n\
+}\n\
+\n\
+/* Answer the YYLIMIT_... that stopped the last parse, or 0. */\n\
+YY_PARSE(int) YYLIMITED(YY_CTX_PARAM)\n\
+{\n\
+    return yyctx->__limited;\n\
+}\n\
+#endif\n\
+\n\
+#ifdef YY_VALIDATE_UTF8\n\
+/* Answer whether the last parse failed because it reached an invalid\n\
+ * UTF-8 sequence.\n\
+ */\n\
+YY_PARSE(int) YYINVALID(YY_CTX_PARAM)\n\
+{\n\
+    return yyctx->__invalid > 1;\n\
+}\n\
+#endif\n\
+\n\
 YY_PARSE(yycontext *) YYRELEASE(yycontext *yyctx)\n\
 {\n\
     if (yyctx->__buflen)\n\
@@ -673,13 +2571,232 @@ YY_PARSE(yycontext *) YYRELEASE(yycontext *yyctx)\n\
         YY_FREE(yyctx->__buf);\n\
         YY_FREE(yyctx->__thunks);\n\
         YY_FREE(yyctx->__vals);\n\
+        if (yyctx->__nodes) YY_FREE(yyctx->__nodes);\n\
+        yyctx->__nodes= 0;\n\
+        yyctx->__nodeslen= 0;\n\
     }\n\
+    yyArenaReset(yyctx, 0);\n\
+#ifdef YY_MEMO\n\
+    if (yyctx->__memorules) YY_FREE(yyctx->__memorules);\n\
+    if (yyctx->__memovisits) YY_FREE(yyctx->__memovisits);\n\
+    if (yyctx->__memos) YY_FREE(yyctx->__memos);\n\
+    if (yyctx->__memothunks) YY_FREE(yyctx->__memothunks);\n\
+    yyctx->__memorules= 0;\n\
+    yyctx->__memovisits= 0;\n\
+    yyctx->__memos= 0;\n\
+    yyctx->__memothunks= 0;\n\
+    yyctx->__memoslen= yyctx->__memocount= yyctx->__memothunkslen= yyctx->__memothunkpos= yyctx->__memogen= 0;\n\
+#endif\n\
     return yyctx;\n\
 }\n\
 \n\
+#ifdef YY_POOL\n\
+#ifndef YY_CTX_LOCAL\n\
+#error \"YY_POOL needs YY_CTX_LOCAL\"\n\
+#endif\n\
+#ifdef YY_PROFILE\n\
+#error \"YY_PROFILE counts without locking and cannot be used with YY_POOL\"\n\
+#endif\n\
+#include <pthread.h>\n\
+\n\
+static pthread_mutex_t yypoollock= PTHREAD_MUTEX_INITIALIZER;\n\
+static pthread_once_t  yypoolonce= PTHREAD_ONCE_INIT;\n\
+static pthread_key_t   yypoolkey;	/* each thread's cached context */\n\
+static yycontext      *yypool[YY_POOL_SIZE];\n\
+static int             yypoolcount= 0;\n\
+\n\
+/* Shrink whatever yy grew beyond YY_POOL_TRIM bytes and forget its input. */\n\
+YY_LOCAL(void) yyTrim(yycontext *yy)\n\
+{\n\
+    if (yy->__buflen > YY_POOL_TRIM)\n\
+    {\n\
+        yy->__buflen= YY_BUFFER_SIZE;\n\
+        yy->__buf= (char *)YY_REALLOC(yy, yy->__buf, yy->__buflen);\n\
+    }\n\
+    if (sizeof(yythunk) * yy->__thunkslen > YY_POOL_TRIM)\n\
+    {\n\
+        yy->__thunkslen= YY_STACK_SIZE;\n\
+        yy->__thunks= (yythunk *)YY_REALLOC(yy, yy->__thunks, sizeof(yythunk) * yy->__thunkslen);\n\
+    }\n\
+    if (sizeof(YYSTYPE) * yy->__valslen > YY_POOL_TRIM)\n\
+    {\n\
+        yy->__valslen= YY_STACK_SIZE;\n\
+        yy->__vals= (YYSTYPE *)YY_REALLOC(yy, yy->__vals, sizeof(YYSTYPE) * yy->__valslen);\n\
+    }\n\
+    if (sizeof(yynode) * yy->__nodeslen > YY_POOL_TRIM)\n\
+    {\n\
+        YY_FREE(yy->__nodes);\n\
+        yy->__nodes= 0;\n\
+        yy->__nodeslen= 0;\n\
+    }\n\
+    yyArenaReset(yy, yy->__chunks && yy->__chunks->size <= YY_POOL_TRIM);\n\
+#ifdef YY_MEMO\n\
+    if (sizeof(yymemo) * yy->__memoslen + sizeof(yythunk) * yy->__memothunkslen > YY_POOL_TRIM)\n\
+    {\n\
+        if (yy->__memos) YY_FREE(yy->__memos);\n\
+        if (yy->__memothunks) YY_FREE(yy->__memothunks);\n\
+        yy->__memos= 0;\n\
+        yy->__memothunks= 0;\n\
+        yy->__memoslen= yy->__memocount= yy->__memothunkslen= 0;\n\
+    }\n\
+#endif\n\
+    yy->__pos= yy->__limit= yy->__offset= yy->__pending= 0;\n\
+    yy->__invalid= 0;\n\
+    yyStart(yy);\n\
+}\n\
+\n\
+YY_LOCAL(void) yyPoolPut(yycontext *yy)\n\
+{\n\
+    pthread_mutex_lock(&yypoollock);\n\
+    if (yypoolcount < YY_POOL_SIZE)\n\
+    {\n\
+        yypool[yypoolcount++]= yy;\n\
+        yy= 0;\n\
+    }\n\
+    pthread_mutex_unlock(&yypoollock);\n\
+    if (yy) free(YYRELEASE(yy));\n\
+}\n\
+\n\
+static void yyPoolExit(void *yy)	{ yyPoolPut((yycontext *)yy); }\n\
+static void yyPoolInit(void)		{ pthread_key_create(&yypoolkey, yyPoolExit); }\n\
+\n\
+/* Answer a context ready to parse, preferably one recycled earlier by\n\
+ * this thread, then one from the shared pool, and otherwise a new one.\n\
+ * Members added with YY_CTX_MEMBERS keep the values they had when the\n\
+ * context was recycled.\n\
+ */\n\
+YY_PARSE(yycontext *) YYACQUIRE(void)\n\
+{\n\
+    yycontext *yy;\n\
+    pthread_once(&yypoolonce, yyPoolInit);\n\
+    if ((yy= (yycontext *)pthread_getspecific(yypoolkey)))\n\
+    {\n\
+        pthread_setspecific(yypoolkey, 0);\n\
+        return yy;\n\
+    }\n\
+    pthread_mutex_lock(&yypoollock);\n\
+    yy= yypoolcount ? yypool[--yypoolcount] : 0;\n\
+    pthread_mutex_unlock(&yypoollock);\n\
+    return yy ? yy : (yycontext *)calloc(1, sizeof(yycontext));\n\
+}\n\
+\n\
+/* Give back a context answered by yyacquire(), keeping its storage\n\
+ * for the next caller.  The calling thread keeps one context for\n\
+ * itself; the pool keeps up to YY_POOL_SIZE more and frees the rest.\n\
+ */\n\
+YY_PARSE(void) YYRECYCLE(yycontext *yy)\n\
+{\n\
+    yyTrim(yy);\n\
+    pthread_once(&yypoolonce, yyPoolInit);\n\
+    if (!pthread_getspecific(yypoolkey) && !pthread_setspecific(yypoolkey, yy))\n\
+        return;\n\
+    yyPoolPut(yy);\n\
+}\n\
+\n\
+/* Free the contexts held by the pool and the one kept by the calling\n\
+ * thread, whose key destructor would not run if the thread is the main\n\
+ * one and leaves by calling exit().\n\
+ */\n\
+YY_PARSE(void) YYDRAIN(void)\n\
+{\n\
+    yycontext *yy;\n\
+    pthread_once(&yypoolonce, yyPoolInit);\n\
+    if ((yy= (yycontext *)pthread_getspecific(yypoolkey)))\n\
+    {\n\
+        pthread_setspecific(yypoolkey, 0);\n\
+        free(YYRELEASE(yy));\n\
+    }\n\
+    for (;;)\n\
+    {\n\
+        pthread_mutex_lock(&yypoollock);\n\
+        yy= yypoolcount ? yypool[--yypoolcount] : 0;\n\
+        pthread_mutex_unlock(&yypoollock);\n\
+        if (!yy) break;\n\
+        free(YYRELEASE(yy));\n\
+    }\n\
+}\n\
+#endif\n\
+\n\
+\n\
+#ifdef YY_PROFILE\n\
+/* Write the number of calls and failures of each rule called so far,\n\
+ * and of successes of each of its alternatives, in the form read by\n\
+ * the -p option.\n\
+ */\n\
+YY_PARSE(void) YYPROFILE(FILE *yyout)\n\
+{\n\
+    yycounts *yyc;\n\
+    int       yyi;\n\
+    for (yyc= yycounted;  yyc;  yyc= yyc->next)\n\
+    {\n\
+        fprintf(yyout, \"%%s %%lu %%lu\", yyc->rule, yyc->calls, yyc->fails);\n\
+        for (yyi= 0;  yyi < yyc->choices;  ++yyi)\n\
+            fprintf(yyout, \" %%lu\", yyc->chosen[yyi]);\n\
+        fprintf(yyout, \"\\n\");\n\
+    }\n\
+}\n\
+#endif\n\
+\n\
 #endif\n\
 ";
 
+enum {
+    NeedsAlloc		= 1<<0,		/* YY_ALLOC: an action calls yyalloc() */
+    NeedsCaseless	= 1<<1,		/* YY_CASELESS: a string is matched ignoring case */
+};
+
+/* Answer the optional parts of the runtime that node, and the nodes
+ * following it, need.
+ */
+static int Node_needs(Node *node)
+{
+    int needs= 0;
+
+    for (;  node;  node= node->any.next)
+        switch (node->type)
+        {
+            case String:
+                if (StringCaseless & node->string.flags) needs |= NeedsCaseless;
+                break;
+            case Action:	if (strstr(node->action.text, "yyalloc")) needs |= NeedsAlloc;		break;
+            case Predicate:	if (strstr(node->predicate.text, "yyalloc")) needs |= NeedsAlloc;	break;
+            case Error:
+                if (strstr(node->error.text, "yyalloc")) needs |= NeedsAlloc;
+                needs |= Node_needs(node->error.element);
+                break;
+            case Alternate:	needs |= Node_needs(node->alternate.first);	break;
+            case Sequence:	needs |= Node_needs(node->sequence.first);	break;
+            case PeekFor:
+            case PeekNot:
+            case Query:
+            case Star:
+            case Plus:		needs |= Node_needs(node->query.element);	break;
+        }
+    return needs;
+}
+
+/* Define the symbols that enable the optional parts of the runtime the
+ * grammar needs, then write the runtime itself.
+ */
+void Rule_compile_c_preamble(void)
+{
+    Node *n;
+    int   needs= 0;
+
+    for (n= rules;  n;  n= n->rule.next)
+        needs |= Node_needs(n->rule.expression);
+    if (NeedsAlloc & needs)
+        fprintf(output, "#ifndef YY_ALLOC\n#define YY_ALLOC\n#endif\n");
+    if (NeedsCaseless & needs)
+        fprintf(output, "#define YY_CASELESS\n");
+    fprintf(output, "%s", preamble);
+}
+
+void Rule_compile_c_footer(void)
+{
+    fprintf(output, footer, start->rule.name);
+}
+
 void Rule_compile_c_header(void)
 {
     fprintf(output, "/* A recursive-descent parser generated by peg %d.%d.%d */\n", PEG_MAJOR, PEG_MINOR, PEG_LEVEL);
@@ -750,28 +2867,306 @@ int consumesInput(Node *node)
 }
 
 
-void Rule_compile_c(Node *node)
+typedef struct {
+    Node **rules;
+    Code  *codes;
+    int    count;
+} RuleJob;
+
+static void Rule_compile_job(void *data, int index)
+{
+    RuleJob *job= data;
+    Code    *code= &job->codes[index];
+    char    *text= Cache_find(job->rules[index]);
+    Buffer_init(&code->buf);
+    code->label= code->scanning= code->hint= 0;
+    if (text)
+        Buffer_append(&code->buf, text, strlen(text));
+    else if (RuleToken & job->rules[index]->rule.flags)
+        Rule_compile_c_token(code, job->rules[index]);
+    else
+        Rule_compile_c2(code, job->rules[index]);
+}
+
+/* Rules are compiled independently into their own buffers (possibly
+ * by several threads, see runParallel()) and written out afterwards in
+ * a deterministic order.
+ */
+static void Rule_compile_c_rules(RuleJob *job, Node *node)
 {
+    char  salt[64];
     Node *n;
+    int   i;
+
+    job->count= 0;
+    for (n= node;  n;  n= n->rule.next)
+    {
+        if (!n->rule.expression)
+            fprintf(stderr, "rule '%s' used but not defined\n", n->rule.name);
+        else
+        {
+            if ((!(RuleUsed & n->rule.flags)) && (n != start))
+                fprintf(stderr, "rule '%s' defined but not used\n", n->rule.name);
+            ++job->count;
+        }
+    }
+    job->rules= malloc(sizeof(Node *) * (job->count + 1));
+    job->codes= malloc(sizeof(Code) * (job->count + 1));
+    for (i= 0, n= node;  n;  n= n->rule.next)
+        if (n->rule.expression)
+            job->rules[i++]= n;
+
+    sprintf(salt, "%s", parseTree ? (splitCount ? "c-split-tree" : "c-tree") : (splitCount ? "c-split" : "c"));
+    if (profileName)
+        sprintf(salt + strlen(salt), " %016llx", profileHash);
+    Cache_begin(salt);
+    runParallel(job->count, Rule_compile_job, job);
+    for (i= 0;  i < job->count;  ++i)
+        Cache_add(job->rules[i], job->codes[i].buf.text);
+    Cache_end();
+}
+
+void Action_compile_c(Node *n)
+{
+    fprintf(output, "YY_ACTION(void) yy%s(yycontext *yy, YY_OFFSET yybegin, YY_OFFSET yyend)\n{\n", n->action.name);
+    defineVariables(n->action.rule->rule.variables);
+    fprintf(output, "  yyprintf((stderr, \"do yy%s\\n\"));\n", n->action.name);
+    if (n->action.binding)
+        fprintf(output, "  %s= __;\n", n->action.binding->variable.name);
+    fprintf(output, "  {\n");
+    fprintf(output, "  %s;\n", n->action.text);
+    fprintf(output, "  }\n");
+    undefineVariables(n->action.rule->rule.variables);
+    fprintf(output, "}\n");
+}
+
+
+int	     splitCount= 0;
+int	     parseTree= 0;
+char	    *profileName= 0;
+
+/* The names of the rules, indexed by the rule numbers in tree nodes. */
+static void Rule_compile_c_names(Node *node)
+{
+    char **names= calloc(ruleCount + 1, sizeof(char *));
+    int    i;
+    for (;  node;  node= node->rule.next)
+        names[node->rule.id]= node->rule.name;
+    fprintf(output, "\n#ifndef YY_PART\n\nYY_PARSE(const char *) yyrulenames[]= {\n  0,\n");
+    for (i= 1;  i <= ruleCount;  ++i)
+        fprintf(output, "  \"%s\",\n", names[i] ? names[i] : "");
+    fprintf(output, "};\n\n#endif\n");
+    free(names);
+}
+static char *splitBase= 0;
+static char *splitMain= 0;
+
+static char *splitName(char *suffix)
+{
+    char *name= malloc(strlen(splitBase) + strlen(suffix) + 1);
+    sprintf(name, "%s%s", splitBase, suffix);
+    return name;
+}
+
+/* Prepare to split the parser named name into a shared header, the
+ * main file name and splitCount rule files.  Answers the name of the
+ * header, to which the output up to and including the preamble and
+ * rule prototypes is written.
+ */
+char *Rule_compile_c_split(char *name)
+{
+    int length= strlen(name);
+    splitMain= name;
+    splitBase= strdup(name);
+    if (length > 2 && !strcmp(name + length - 2, ".c"))
+        splitBase[length - 2]= '\0';
+    return splitName(".h");
+}
+
+static char *splitInclude(void)
+{
+    char *header= splitName(".h"), *slash= strrchr(header, '/');
+    return slash ? slash + 1 : header;
+}
+
+static void Node_order(Node *node, char *visited, int *index, int *order, int *count)
+{
+    for (;  node;  node= node->any.next)
+        switch (node->type)
+        {
+            case Name:
+                {
+                    Node *rule= node->name.rule;
+                    if (rule->rule.expression && !visited[rule->rule.id])
+                    {
+                        visited[rule->rule.id]= 1;
+                        order[(*count)++]= index[rule->rule.id];
+                        Node_order(rule->rule.expression, visited, index, order, count);
+                    }
+                }
+                break;
+            case Error:		Node_order(node->error.element, visited, index, order, count);		break;
+            case Alternate:	Node_order(node->alternate.first, visited, index, order, count);	break;
+            case Sequence:	Node_order(node->sequence.first, visited, index, order, count);		break;
+            case PeekFor:
+            case PeekNot:
+            case Query:
+            case Star:
+            case Plus:		Node_order(node->query.element, visited, index, order, count);		break;
+            default:												break;
+        }
+}
+
+/* Answer YY_COLD for a rule that cannot be reached from the start rule
+ * or, given a profile, was never called, and YY_HOT for a rule that the
+ * profile shows called more often than most.  Scanners are called
+ * directly and not counted, so the profile says nothing about tokens.
+ */
+static char *Rule_temperature(Node *rule, char *reached)
+{
+    if (!reached[rule->rule.id])
+        return "YY_COLD ";
+    if (profileCount && !(RuleToken & rule->rule.flags))
+    {
+        if (!profileCalls[rule->rule.id])			return "YY_COLD ";
+        if (profileCalls[rule->rule.id] > profileMean)		return "YY_HOT ";
+    }
+    return "";
+}
+
+/* Answer the order in which to write the rules of job: depth-first call
+ * order from the start rule, so that a rule tends to be placed near the
+ * rules it calls, with the cold rules moved to the end.  The rules that
+ * were reached are marked in reached.
+ */
+static int *Rule_order(RuleJob *job, char *reached)
+{
+    int *index= calloc(ruleCount + 1, sizeof(int));
+    int *order= malloc(sizeof(int) * (job->count + 1));
+    int *cold= malloc(sizeof(int) * (job->count + 1));
+    int  count= 0, colds= 0, hot= 0, i;
+
+    for (i= 0;  i < job->count;  ++i)
+        index[job->rules[i]->rule.id]= i;
+    if (start->rule.expression)
+    {
+        reached[start->rule.id]= 1;
+        order[count++]= index[start->rule.id];
+        Node_order(start->rule.expression, reached, index, order, &count);
+    }
+    for (i= 0;  i < job->count;  ++i)
+        if (!reached[job->rules[i]->rule.id])
+            order[count++]= i;
+    for (i= 0;  i < count;  ++i)
+        if (strcmp(Rule_temperature(job->rules[order[i]], reached), "YY_COLD "))
+            order[hot++]= order[i];
+        else
+            cold[colds++]= order[i];
+    memcpy(order + hot, cold, sizeof(int) * colds);
+    free(index);
+    free(cold);
+    return order;
+}
+
+/* Write the rules into splitCount files, taking them in the given order
+ * and cutting the sequence into pieces of roughly equal size, so that a
+ * rule tends to share a file with the rules it calls.  Actions go with
+ * their rules.
+ */
+static void Rule_compile_c_parts(RuleJob *job, int *order)
+{
+    char *visited= calloc(ruleCount + 1, 1);
+    int   total= 0, done= 0, next= 0, part, i;
+
+    for (i= 0;  i < job->count;  ++i)
+        total += job->codes[i].buf.length;
+
+    for (part= 1;  part <= splitCount;  ++part)
+    {
+        char  suffix[32];
+        int   first= next;
+        Node *n;
+        sprintf(suffix, "-%d.c", part);
+        output= openOutput(splitName(suffix));
+        fprintf(output, "/* Part %d of %d of a recursive-descent parser generated by peg %d.%d.%d */\n\n", part, splitCount, PEG_MAJOR, PEG_MINOR, PEG_LEVEL);
+        fprintf(output, "#define YY_SPLIT_PART\n#include \"%s\"\n", splitInclude());
+        while (next < job->count && (part == splitCount || (long)done * splitCount < (long)total * part))
+        {
+            visited[job->rules[order[next]]->rule.id]= part + 1;
+            done += job->codes[order[next++]].buf.length;
+        }
+        for (n= actions;  n;  n= n->action.list)
+            if (visited[n->action.rule->rule.id] == part + 1)
+                Action_compile_c(n);
+        for (i= first;  i < next;  ++i)
+            fputs(job->codes[order[i]].buf.text, output);
+        fprintf(output, "\n");
+        closeOutput(output);
+    }
+    free(visited);
+}
+
+void Rule_compile_c(Node *node)
+{
+    RuleJob job;
+    Node   *n;
+    char   *reached= calloc(ruleCount + 1, 1);
+    int    *order, i;
 
     for (n= rules;  n;  n= n->rule.next)
         consumesInput(n);
+    Rule_findTokens(rules);
+    if (profileName)
+        Rule_readProfile();
+    Rule_reorder(rules);
+    Rule_effects(rules);
+    Rule_frames(rules);
+    Rule_findEager(rules);
+    Rule_findMemo(rules);
 
-    fprintf(output, "%s", preamble);
+    Rule_compile_c_rules(&job, node);
+    order= Rule_order(&job, reached);
+
+    if (splitCount)
+    {
+        fprintf(output, "#undef YY_RULE\n#define YY_RULE(T)\tT\n");
+        fprintf(output, "#ifndef YY_LOCAL\n#define YY_LOCAL(T)\tstatic YY_UNUSED T\n#endif\n");	/* each part uses only some */
+    }
+    if (parseTree)
+        fprintf(output, "#define YY_TREE\n");
+    fprintf(output, "#define YY_RULE_COUNT %d\n", ruleCount);
+    Rule_compile_c_preamble();
     for (n= node;  n;  n= n->rule.next)
-        fprintf(output, "YY_RULE(int) yy_%s(yycontext *yy); /* %d */\n", n->rule.name, n->rule.id);
+    {
+        char *temperature= n->rule.expression ? Rule_temperature(n, reached) : "";
+        fprintf(output, "%s%sYY_RULE(int) yy_%s(yycontext *yy); /* %d */\n", (RuleToken & n->rule.flags) ? "YY_UNUSED " : "", temperature, n->rule.name, n->rule.id);
+        if (RuleToken & n->rule.flags)
+            fprintf(output, "%sYY_RULE(YY_OFFSET) yyscan_%s(yycontext *yy, YY_OFFSET yyp0);\n", temperature, n->rule.name);
+    }
     fprintf(output, "\n");
-    for (n= actions;  n;  n= n->action.list)
-    {
-        fprintf(output, "YY_ACTION(void) yy%s(yycontext *yy, int yybegin, int yyend)\n{\n", n->action.name);
-        defineVariables(n->action.rule->rule.variables);
-        fprintf(output, "  yyprintf((stderr, \"do yy%s\\n\"));\n", n->action.name);
-        fprintf(output, "  {\n");
-        fprintf(output, "  %s;\n", n->action.text);
-        fprintf(output, "  }\n");
-        undefineVariables(n->action.rule->rule.variables);
-        fprintf(output, "}\n");
-    }
-    Rule_compile_c2(node);
+    if (splitCount)
+    {
+        closeOutput(output);
+        Rule_compile_c_parts(&job, order);
+        output= openOutput(splitMain);
+        fprintf(output, "/* A recursive-descent parser generated by peg %d.%d.%d */\n\n", PEG_MAJOR, PEG_MINOR, PEG_LEVEL);
+        fprintf(output, "#include \"%s\"\n", splitInclude());
+    }
+    else
+    {
+        for (n= actions;  n;  n= n->action.list)
+            Action_compile_c(n);
+        for (i= 0;  i < job.count;  ++i)
+            fputs(job.codes[order[i]].buf.text, output);
+    }
+    for (i= 0;  i < job.count;  ++i)
+        Buffer_release(&job.codes[i].buf);
+    free(job.rules);
+    free(job.codes);
+    free(order);
+    free(reached);
+    if (parseTree)
+        Rule_compile_c_names(node);
     fprintf(output, footer, start->rule.name);
+    Profile_release();
 }
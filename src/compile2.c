@@ -19,6 +19,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
 #include <assert.h>
 #include <stdarg.h>
 
@@ -30,176 +31,272 @@
 #include "version.h"
 #include "tree.h"
 
-static char *buffer = NULL;
-static int bufpos = -1;
-static int buflen = -1;
+/* Character sets and first-byte dispatch tables are precomputed here
+ * and emitted once, as static fields of the parser class, rather than
+ * as strings that the runtime would have to parse again.  Each is named
+ * after a hash of its contents, so that the same set used by several
+ * rules is declared only once and the text generated for a rule (which
+ * may come from the cache) never depends on the order of declarations.
+ */
 
-static void clearbuffer() {
-    free(buffer);
-    bufpos = buflen = -1;
-    buffer = NULL;
-}
+typedef unsigned long long Hash;
 
-static void makebuffer() {
-    if (buffer) {
-        clearbuffer();
-    }
-    buflen = 1024;
-    buffer = malloc(buflen);
-    bufpos = 0;
+static Hash hashBytes(unsigned char *p, int length)
+{
+    Hash h = 0xcbf29ce484222325ULL;
+    while (length--)
+        h = (h ^ *p++) * 0x100000001b3ULL;
+    return h;
 }
 
-static void expandbuf(int length) {
-    while (buflen - bufpos < length + 1) {
-        buflen *= 2;
-        buffer = realloc(buffer, buflen);
+static Buffer declarations;
+static char **declared;
+static int    declaredCount, declaredSize;
+
+static void declare(char *name, char *text)
+{
+    int i;
+    for (i = 0; i < declaredCount; i++)
+        if (!strcmp(declared[i], name))
+            return;
+    if (declaredCount == declaredSize) {
+        declaredSize = declaredSize ? declaredSize * 2 : 64;
+        declared = realloc(declared, sizeof(char *) * declaredSize);
     }
-    memset(buffer + bufpos, 0, buflen - bufpos);
+    declared[declaredCount++] = strdup(name);
+    Buffer_printf(&declarations, "%s", text);
 }
 
-static void insert(const char *fmt) {
-    char tmp[buflen + 1];
-    memcpy(tmp, buffer, buflen);
-    expandbuf(strlen(fmt));
-    memcpy(buffer, fmt, strlen(fmt));
-    memcpy(buffer + strlen(fmt), tmp, bufpos);
-    bufpos += strlen(fmt);
+static void setName(char *name, unsigned char bits[32])
+{
+    sprintf(name, "yyset_%016llx", hashBytes(bits, 32));
 }
 
-static void writebuf(const char *fmt, ...) {
-    va_list ap;
-    va_start(ap, fmt);
-    char tmp[1024];
-    int len = vsprintf(tmp, fmt, ap);
-    va_end(ap);
-    expandbuf(len + 1);
-    memcpy(buffer + bufpos, tmp, len);
-    assert(bufpos + len = strlen(buffer));
-    bufpos += len;
+/* Declare a 256-bit set as four 64-bit words, lowest bytes first. */
+static void declareSet(unsigned char bits[32])
+{
+    Buffer text;
+    char   name[32];
+    int    i, j;
+    setName(name, bits);
+    Buffer_init(&text);
+    Buffer_printf(&text, "\tstatic final long[] %s = {", name);
+    for (i = 0; i < 4; i++) {
+        unsigned long long word = 0;
+        for (j = 7; j >= 0; j--)
+            word = (word << 8) | bits[i * 8 + j];
+        Buffer_printf(&text, "%s 0x%016llxL", i ? "," : "", word);
+    }
+    Buffer_printf(&text, " };\n");
+    declare(name, text.text);
+    Buffer_release(&text);
 }
 
-
-static int yyl(void)
+static void letterSet(unsigned char bits[32], int c)
 {
-    static int prev= 0;
-    return ++prev;
+    memset(bits, 0, 32);
+    bits[toupper(c) >> 3] |= 1 << (toupper(c) & 7);
+    bits[tolower(c) >> 3] |= 1 << (tolower(c) & 7);
 }
 
-static inline int ishex(int c) {
-    return ('0' <= c && c <= '9') ||
-        ('a' <= c && c <= 'f') ||
-        ('A' <= c && c <= 'F');
+/* Answer whether the alternatives of node all consume input and start
+ * with disjoint sets of bytes, setting map to the number (from 1) of
+ * the only alternative that can match after each byte, or 0.
+ */
+static int Alternate_map(Node *node, unsigned char map[256])
+{
+    unsigned char bits[32];
+    char         *visiting = calloc(ruleCount + 1, 1);
+    int           count = 0, c, ok = 1;
+
+    memset(map, 0, 256);
+    for (node = node->alternate.first; ok && node; node = node->alternate.next) {
+        if (++count > 127 || !Node_firstSet(node, bits, visiting)) {
+            ok = 0;
+            break;
+        }
+        for (c = 0; c < 256; c++)
+            if (bits[c >> 3] & (1 << (c & 7))) {
+                if (map[c]) ok = 0;
+                map[c] = count;
+            }
+    }
+    free(visiting);
+    return ok;
 }
 
-static inline int hex2num(int c) {
-    if('0' <= c && c <= '9') return c - '0';
-    else if('a' <= c && c <= 'f') return c - 'a';
-    else return c - 'A';
+static void mapName(char *name, unsigned char map[256])
+{
+    sprintf(name, "yymap_%016llx", hashBytes(map, 256));
 }
 
+static void declareMap(unsigned char map[256])
+{
+    Buffer text;
+    char   name[32];
+    int    c;
+    mapName(name, map);
+    Buffer_init(&text);
+    Buffer_printf(&text, "\tstatic final byte[] %s = {", name);
+    for (c = 0; c < 256; c++)
+        Buffer_printf(&text, "%s%s%d", c ? "," : "", c % 32 ? "" : "\n\t\t", map[c]);
+    Buffer_printf(&text, "\n\t};\n");
+    declare(name, text.text);
+    Buffer_release(&text);
+}
 
-static int cnext(unsigned char **ccp)
+/* Declare the sets and tables that Node_compile_green() will refer to
+ * for node and its siblings.
+ */
+static void Node_declare_green(Node *node)
 {
-    unsigned char *cclass= *ccp;
-    int c = *cclass++;
-    if (c) {
-        if ('\\' == c && *cclass) {
-            switch (c = *cclass++) {
-            case 'a':  c = '\a';   break;    /* bel */
-            case 'b':  c = '\b';   break;    /* bs */
-            case 'e':  c = '\033'; break;    /* esc */
-            case 'f':  c = '\f';   break;    /* ff */
-            case 'n':  c = '\n';   break;    /* nl */
-            case 'r':  c = '\r';   break;    /* cr */
-            case 't':  c = '\t';   break;    /* ht */
-            case 'v':  c = '\v';   break;    /* vt */
-            case 'u':
-            default:
-                       if (ishex(c)) {
-                           c = hex2num(c);
-                           if (ishex(*cclass)) c = (c * 16) + hex2num(*cclass++);
-                           if (ishex(*cclass)) c = (c * 16) + hex2num(*cclass++);
-                       }
-                       break;
-            }
+    unsigned char bits[32], map[256], *text;
+    int           c;
+
+    for (; node; node = node->any.next)
+        switch (node->type) {
+        case String:
+            if (StringCaseless & node->string.flags)
+                for (text = (unsigned char *)node->string.value; *text; )
+                    if ((c = Char_next(&text)) < 128 && isalpha(c)) {
+                        letterSet(bits, c);
+                        declareSet(bits);
+                    }
+            break;
+        case Class:
+            Class_bits(bits, node->cclass.value);
+            declareSet(bits);
+            break;
+        case Alternate:
+            if (Alternate_map(node, map))
+                declareMap(map);
+            Node_declare_green(node->alternate.first);
+            break;
+        case Error:     Node_declare_green(node->error.element);    break;
+        case Sequence:  Node_declare_green(node->sequence.first);   break;
+        case PeekFor:
+        case PeekNot:
+        case Query:
+        case Star:
+        case Plus:      Node_declare_green(node->query.element);    break;
         }
-        *ccp= cclass;
-    }
-    return c;
 }
 
-static void charClassSet  (unsigned char bits[], int c) {
-    bits[c] =  1;
-}
+static void Node_compile_green(Buffer *buf, Node *node);
 
-static void charClassClear(unsigned char bits[], int c) {
-    bits[c] = 0;
+static void Set_compile_green(Buffer *buf, unsigned char bits[32])
+{
+    char name[32];
+    setName(name, bits);
+    Buffer_printf(buf, "charset(%s)", name);
 }
 
-typedef void (*setter)(unsigned char bits[], int c);
-
-
-static char *makeCharClass(unsigned char *cclass)
+/* There is no case-insensitive terminal in green, so each letter of a
+ * caseless string is matched as a set.  Answer the number of elements
+ * written after the count already written.
+ */
+static int Caseless_compile_green(Buffer *buf, Node *node, int count)
 {
-#define VECTOR_LENGTH (256)
-    unsigned char bits[VECTOR_LENGTH];
-    setter set;
-    int    c, prev= -1;
-    static char string[512] = {};
-    char *ptr;
-
-    memset(string, 0, 512);
-    if ('^' == *cclass) {
-        memset(bits, 255, sizeof(unsigned char) * VECTOR_LENGTH);
-        set= charClassClear;
-        ++cclass;
-    }
-    else {
-        memset(bits, 0, sizeof(unsigned char) * VECTOR_LENGTH);
-        set= charClassSet;
+    unsigned char bits[32], *text = (unsigned char *)node->string.value, *start;
+
+    while (*text) {
+        int c = Char_next((start = text, &text));
+        if (count++) { Buffer_printf(buf, ", "); }
+        if (c < 128 && isalpha(c)) {
+            letterSet(bits, c);
+            Set_compile_green(buf, bits);
+        }
+        else
+            Buffer_printf(buf, "string(\"%.*s\")", (int)(text - start), start);
     }
-    while (*cclass) {
-        if ('-' == *cclass && cclass[1] && prev >= 0) {
-            ++cclass;
-            for (c = cnext(&cclass);  prev <= c;  ++prev)
-                set(bits, prev);
-            prev= -1;
+    return count;
+}
+
+/* Write the elements of a sequence without actions, splicing in those
+ * of nested sequences (which group only for the benefit of a suffix or
+ * an alternative), and answer how many were written.
+ */
+static int Elements_compile_green(Buffer *buf, Node *node, Node *end, int count)
+{
+    for (; node != end; node = node->sequence.next) {
+        Node *n;
+        if (Sequence == node->type) {
+            for (n = node->sequence.first; n && Action != n->type; n = n->sequence.next);
+            if (!n) {
+                count = Elements_compile_green(buf, node->sequence.first, 0, count);
+                continue;
+            }
         }
-        else {
-            c = cnext(&cclass);
-            set(bits, prev= c);
+        if (String == node->type && (StringCaseless & node->string.flags) && *node->string.value) {
+            count = Caseless_compile_green(buf, node, count);
+            continue;
         }
+        if (count++) { Buffer_printf(buf, ", "); }
+        Node_compile_green(buf, node);
     }
+    return count;
+}
 
-    ptr= string;
-    for (c = 0; c < VECTOR_LENGTH; c++) {
-        if (bits[c]) {
-            switch (c) {
-            case '\a':  *ptr++ = '\\'; *ptr++ = 'a'; break;    /* bel */
-            case '\b':  *ptr++ = '\\'; *ptr++ = 'b'; break;    /* bs */
-            case '\f':  *ptr++ = '\\'; *ptr++ = 'f'; break;    /* ff */
-            case '\n':  *ptr++ = '\\'; *ptr++ = 'n'; break;    /* nl */
-            case '\r':  *ptr++ = '\\'; *ptr++ = 'r'; break;    /* cr */
-            case '\t':  *ptr++ = '\\'; *ptr++ = 't'; break;    /* ht */
-            case '\v':  *ptr++ = '\\'; *ptr++ = 'v'; break;    /* vt */
-            default:
-                       if (c >= 0x20) {
-                           ptr += sprintf(ptr, "%c", c);
-                       }
-            }
+/* Each action applies to the part of its sequence that precedes it,
+ * so the elements before an action become the first argument of its
+ * apply().  A group of one element is written without seq().
+ */
+static void Sequence_compile_green(Buffer *buf, Node *node)
+{
+    Buffer items, group;
+    Node  *n, *from = node->sequence.first;
+    int    count = 0;
+
+    Buffer_init(&items);
+    for (n = from; ; n = n->sequence.next) {
+        if (n && Action != n->type)
+            continue;
+        Buffer_init(&group);
+        if (count) Buffer_printf(&group, "%s", items.text);
+        count = Elements_compile_green(&group, from, n, count);
+        if (n) {
+            Buffer_release(&items);
+            Buffer_init(&items);
+            if (1 == count)
+                Buffer_printf(&items, "apply(%s, new YY%s())", group.text, n->action.name);
+            else
+                Buffer_printf(&items, "apply(seq(%s), new YY%s())", count ? group.text : "", n->action.name);
+            count = 1;
+            from = n->sequence.next;
+            Buffer_release(&group);
+        }
+        else {
+            Buffer_release(&items);
+            items = group;
+            break;
         }
     }
+    if (1 == count)
+        Buffer_printf(buf, "%s", items.text);
+    else
+        Buffer_printf(buf, "seq(%s)", count ? items.text : "");
+    Buffer_release(&items);
+}
 
-    return string;
+/* Write the alternatives of node, splicing in those of nested choices. */
+static int Alternatives_compile_green(Buffer *buf, Node *node, int count)
+{
+    for (node = node->alternate.first; node; node = node->alternate.next)
+        if (Alternate == node->type)
+            count = Alternatives_compile_green(buf, node, count);
+        else {
+            if (count++) { Buffer_printf(buf, ", "); }
+            Node_compile_green(buf, node);
+        }
+    return count;
 }
 
-static void Node_compile_c_ko(Node *node, int ko)
+static void Node_compile_green(Buffer *buf, Node *node)
 {
+    unsigned char bits[32], map[256];
+    char          name[32];
+
     assert(node);
-    int i = 0;
-    int ok = 0;
-    int qok = 0;
-    int out = 0;
     switch (node->type) {
     case Rule:
         fprintf(stderr, "\ninternal error #1 (%s)\n", node->rule.name);
@@ -207,118 +304,149 @@ static void Node_compile_c_ko(Node *node, int ko)
         break;
 
     case Dot:
-        writebuf("any");
+        Buffer_printf(buf, "any");
         break;
 
     case Name:
-        writebuf("%s", node->name.rule->rule.name);
+        Buffer_printf(buf, "%s", node->name.rule->rule.name);
         return;
 
     case Character:
     case String:
-        writebuf("string(\"%s\")", node->string.value);
+        if (String == node->type && (StringCaseless & node->string.flags)) {
+            Buffer_printf(buf, "seq(");
+            Caseless_compile_green(buf, node, 0);
+            Buffer_printf(buf, ")");
+        }
+        else
+            Buffer_printf(buf, "string(\"%s\")", node->string.value);
         break;
 
     case Class:
-        writebuf("charctor(\"%s\")", makeCharClass(node->cclass.value));
+        Class_bits(bits, node->cclass.value);
+        Set_compile_green(buf, bits);
         break;
 
     case Action:
-        {
-            insert("seq(apply(");
-            bufpos -= 2;
-            writebuf("),");
-            writebuf("new YY%s())", node->action.name);
-            break;
-        }
+        Buffer_printf(buf, "apply(seq(), new YY%s())", node->action.name);
+        break;
 
     case Predicate:
-        writebuf("predicate:%s", node->action.text);
+        Buffer_printf(buf, "predicate:%s", node->action.text);
         break;
 
     case Error:
         break;
 
     case Alternate:
-        writebuf("or(");
-        for (node= node->alternate.first; node; node= node->alternate.next) {
-            if (i != 0) { writebuf(", "); }
-            Node_compile_c_ko(node, ko);
-            i++;
+        if (Alternate_map(node, map)) {
+            /* the alternatives are not flattened: the table numbers them as they are */
+            mapName(name, map);
+            Buffer_printf(buf, "dispatch(%s", name);
+            for (node = node->alternate.first; node; node = node->alternate.next) {
+                Buffer_printf(buf, ", ");
+                Node_compile_green(buf, node);
+            }
         }
-        writebuf(")");
+        else {
+            Buffer_printf(buf, "or(");
+            Alternatives_compile_green(buf, node, 0);
+        }
+        Buffer_printf(buf, ")");
         break;
 
     case Sequence:
-        writebuf("seq(");
-        for (node= node->sequence.first; node; node= node->sequence.next) {
-            if (i != 0) { writebuf(", "); }
-            Node_compile_c_ko(node, ko);
-            i++;
-        }
-        writebuf(")");
+        Sequence_compile_green(buf, node);
         break;
 
     case PeekFor:
-        writebuf("peekfor(");
-        Node_compile_c_ko(node->peekFor.element, ko);
-        writebuf(")");
+        Buffer_printf(buf, "peekfor(");
+        Node_compile_green(buf, node->peekFor.element);
+        Buffer_printf(buf, ")");
         break;
 
     case PeekNot:
-        writebuf("not(");
-        Node_compile_c_ko(node->star.element, ok);
-        writebuf(")");
+        Buffer_printf(buf, "not(");
+        Node_compile_green(buf, node->peekNot.element);
+        Buffer_printf(buf, ")");
         break;
 
     case Query:
-        writebuf("opt(");
-        Node_compile_c_ko(node->star.element, qok);
-        writebuf(")");
+        Buffer_printf(buf, "opt(");
+        Node_compile_green(buf, node->query.element);
+        Buffer_printf(buf, ")");
         break;
 
     case Star:
-        writebuf("repeat(");
-        Node_compile_c_ko(node->star.element, out);
-        writebuf(")");
+        Buffer_printf(buf, "repeat(");
+        Node_compile_green(buf, node->star.element);
+        Buffer_printf(buf, ")");
         break;
 
     case Plus:
-        writebuf("repeat1(");
-        Node_compile_c_ko(node->plus.element, ko);
-        writebuf(")");
+        Buffer_printf(buf, "repeat1(");
+        Node_compile_green(buf, node->plus.element);
+        Buffer_printf(buf, ")");
         break;
 
     default:
-        fprintf(stderr, "\nNode_compile_c_ko: illegal node type %d\n", node->type);
+        fprintf(stderr, "\nNode_compile_green: illegal node type %d\n", node->type);
         exit(1);
     }
 }
 
+typedef struct {
+    Node  **rules;
+    Buffer *bufs;
+} GreenJob;
+
+static void Rule_compile_green_job(void *data, int index) {
+    GreenJob *job = data;
+    Node *node = job->rules[index];
+    Buffer *buf = &job->bufs[index];
+    char *text = Cache_find(node);
+    Buffer_init(buf);
+    if (text) {
+        Buffer_append(buf, text, strlen(text));
+        return;
+    }
+    Buffer_printf(buf, "%s.Target = ", node->rule.name);
+    Node_compile_green(buf, node->rule.expression);
+    Buffer_printf(buf, ";\n");
+}
+
 static void Rule_compile_green2(Node *node)
 {
-    assert(node);
-    assert(Rule == node->type);
-
-    if (!node->rule.expression)
-        fprintf(stderr, "rule '%s' used but not defined\n", node->rule.name);
-    else {
-        int ko= yyl(), safe;
-
-        if ((!(RuleUsed & node->rule.flags)) && (node != start))
-            fprintf(stderr, "rule '%s' defined but not used\n", node->rule.name);
-
-        safe= ((Query == node->rule.expression->type) || (Star == node->rule.expression->type));
+    GreenJob job;
+    Node *n;
+    int count = 0, i;
 
-        fprintf(output, "%s.Target = ", node->rule.name);
-        makebuffer();
-        Node_compile_c_ko(node->rule.expression, ko);
-        fprintf(output, "%s;\n", buffer);
-        clearbuffer();
+    for (n = node; n; n = n->rule.next) {
+        if (!n->rule.expression)
+            fprintf(stderr, "rule '%s' used but not defined\n", n->rule.name);
+        else {
+            if ((!(RuleUsed & n->rule.flags)) && (n != start))
+                fprintf(stderr, "rule '%s' defined but not used\n", n->rule.name);
+            count++;
+        }
     }
-
-    if (node->rule.next)
-        Rule_compile_green2(node->rule.next);
+    job.rules = malloc(sizeof(Node *) * (count + 1));
+    job.bufs = malloc(sizeof(Buffer) * (count + 1));
+    for (count = 0, n = node; n; n = n->rule.next)
+        if (n->rule.expression)
+            job.rules[count++] = n;
+
+    Cache_begin("green");
+    runParallel(count, Rule_compile_green_job, &job);
+
+    for (i = 0; i < count; i++) {
+        fputs(job.bufs[i].text, output);
+        Cache_add(job.rules[i], job.bufs[i].text);
+        Buffer_release(&job.bufs[i]);
+    }
+    Cache_end();
+    free(job.rules);
+    free(job.bufs);
 }
 
 
@@ -389,9 +517,70 @@ int consumeInput2(Node *node)
 }
 
 
+/* A rule is worth memoizing when the parser may call it twice at the
+ * same position: when it begins two alternatives of one choice, or a
+ * predicate and the element that follows it.  Rules that match a
+ * single terminal are cheaper to run again than to look up.
+ */
+static Node *leadingRule(Node *node)
+{
+    switch (node->type) {
+    case Name:      return node->name.rule;
+    case Error:     return leadingRule(node->error.element);
+    case Sequence:
+        for (node = node->sequence.first; node; node = node->sequence.next)
+            if (Action != node->type && Predicate != node->type)
+                return leadingRule(node);
+        break;
+    }
+    return 0;
+}
+
+static void Node_memo_green(Node *node, char *memo)
+{
+    Node *n, *m, *r;
+
+    for (; node; node = node->any.next)
+        switch (node->type) {
+        case Alternate:
+            for (n = node->alternate.first; n; n = n->alternate.next)
+                if ((r = leadingRule(n)))
+                    for (m = n->alternate.next; m; m = m->alternate.next)
+                        if (leadingRule(m) == r)
+                            memo[r->rule.id] = 1;
+            Node_memo_green(node->alternate.first, memo);
+            break;
+        case Sequence:
+            for (n = node->sequence.first; n; n = n->sequence.next)
+                if ((PeekFor == n->type || PeekNot == n->type) && n->sequence.next
+                    && (r = leadingRule(n->query.element)) && leadingRule(n->sequence.next) == r)
+                    memo[r->rule.id] = 1;
+            Node_memo_green(node->sequence.first, memo);
+            break;
+        case Error:     Node_memo_green(node->error.element, memo);     break;
+        case PeekFor:
+        case PeekNot:
+        case Query:
+        case Star:
+        case Plus:      Node_memo_green(node->query.element, memo);     break;
+        }
+}
+
+static int isTerminal(Node *node)
+{
+    switch (node->type) {
+    case Dot:
+    case Character:
+    case String:
+    case Class:     return 1;
+    }
+    return 0;
+}
+
 void Rule_compile_green(Node *node)
 {
     Node *n;
+    char *memo;
 
     for (n = actions; n; n = n->action.list) {
         fprintf(output, "class YY%s implements Transformer<T1, T2> {\n", n->action.name);
@@ -402,7 +591,14 @@ void Rule_compile_green(Node *node)
         fprintf(output, "}\n");
     }
 
+    Buffer_init(&declarations);
+    for (n = node; n; n = n->rule.next)
+        if (n->rule.expression)
+            Node_declare_green(n->rule.expression);
+
     fprintf(output, "class %sParser {\n", start->rule.name);
+    fputs(declarations.text, output);
+    if (declaredCount) { fprintf(output, "\n"); }
     fprintf(output, "\tpublic static Parser<Object> NewInstance() {\n");
     for (n = node; n; n = n->rule.next) {
         fprintf(output, "SymbolParser<Object> %s = symbol(null); /* %d */\n", n->rule.name, n->rule.id);
@@ -415,6 +611,17 @@ void Rule_compile_green(Node *node)
     }
 
     Rule_compile_green2(node);
+
+    memo = calloc(ruleCount + 1, 1);
+    for (n = node; n; n = n->rule.next)
+        if (n->rule.expression)
+            Node_memo_green(n->rule.expression, memo);
+    for (n = node; n; n = n->rule.next)
+        if (memo[n->rule.id] && n->rule.expression && !isTerminal(n->rule.expression))
+            fprintf(output, "memo(%s);\n", n->rule.name);
+    free(memo);
+    Buffer_release(&declarations);
+
     fprintf(output, "\t\treturn %s;\n", start->rule.name);
     fprintf(output, "\t}\n");
     fprintf(output, "}\n");
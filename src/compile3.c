@@ -0,0 +1,565 @@
+/* Copyright (c) 2007, 2012 by Ian Piumarta
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the 'Software'),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, provided that the above copyright notice(s) and this
+ * permission notice appear in all copies of the Software.  Acknowledgement
+ * of the use of this Software in supporting documentation would be
+ * appreciated but is not required.
+ *
+ * THE SOFTWARE IS PROVIDED 'AS IS'.  USE ENTIRELY AT YOUR OWN RISK.
+ */
+
+/* Bytecode backend.  Rules are compiled into a single array of
+ * instructions for a small backtracking machine whose interpreter is
+ * emitted along with the usual runtime.  Each rule still gets a
+ * function yy_<rule>() so that the generated parser has the same
+ * interface as one produced by Rule_compile_c().
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "version.h"
+#include "tree.h"
+
+enum {
+    OpFail, OpDot, OpChar, OpString, OpClass, OpCall, OpReturn, OpChoice, OpCommit, OpPartial,
+    OpBack, OpFailTwice, OpJump, OpAction, OpPredicate, OpError, OpPush, OpPop, OpSet, OpCaseless, OpCount
+};
+
+static char *opNames[OpCount]= {
+    "YYOP_FAIL", "YYOP_DOT", "YYOP_CHAR", "YYOP_STRING", "YYOP_CLASS", "YYOP_CALL", "YYOP_RETURN", "YYOP_CHOICE", "YYOP_COMMIT", "YYOP_PARTIAL",
+    "YYOP_BACK", "YYOP_FAILTWICE", "YYOP_JUMP", "YYOP_ACTION", "YYOP_PREDICATE", "YYOP_ERROR", "YYOP_PUSH", "YYOP_POP", "YYOP_SET", "YYOP_CASELESS"
+};
+
+static int opOperands[OpCount]= {
+    0, 0, 1, 1, 1, 1, 0, 1, 1, 1,
+    1, 0, 1, 1, 1, 1, 1, 1, 1, 1
+};
+
+static int opIsJump(int op)
+{
+    return OpChoice == op || OpCommit == op || OpPartial == op || OpBack == op || OpJump == op;
+}
+
+typedef struct Instruction Instruction;
+
+struct Instruction {
+    int   op;
+    int   arg;	/* operand; the target instruction for jumps */
+    char *text;	/* operand written as C text, if any */
+};
+
+static Instruction *program= 0;
+static int	    programSize= 0;
+static int	    programCapacity= 0;
+
+/* Strings and character classes are emitted once however often they
+ * appear in the grammar.
+ */
+typedef struct Table Table;
+
+struct Table {
+    Buffer   text;	/* initialisers of the emitted array */
+    int      count;
+    char   **keys;	/* open-addressed hash of the entries */
+    int     *indices;
+    int      size;
+};
+
+static Table	    strings, classes;
+static Buffer	    predicates, errors, actionTable;
+static int	    predicateCount, errorCount, actionCount;
+
+static void Table_init(Table *table)
+{
+    Buffer_init(&table->text);
+    table->count= 0;
+    table->size= 64;
+    table->keys= calloc(table->size, sizeof(char *));
+    table->indices= calloc(table->size, sizeof(int));
+}
+
+static void Table_release(Table *table)
+{
+    int i;
+    for (i= 0;  i < table->size;  ++i)
+        free(table->keys[i]);
+    free(table->keys);
+    free(table->indices);
+    Buffer_release(&table->text);
+}
+
+static unsigned int hashString(char *key)
+{
+    unsigned int hash= 2166136261u;
+    while (*key) hash= (hash ^ (unsigned char)*key++) * 16777619u;
+    return hash;
+}
+
+static int Table_intern(Table *table, char *key)
+{
+    unsigned int i= hashString(key) & (table->size - 1);
+    while (table->keys[i])
+    {
+        if (!strcmp(table->keys[i], key))
+            return table->indices[i];
+        i= (i + 1) & (table->size - 1);
+    }
+    table->keys[i]= strdup(key);
+    table->indices[i]= table->count;
+    Buffer_printf(&table->text, "  \"%s\",\n", key);
+    if (2 * ++table->count > table->size)
+    {
+        char **keys= table->keys;
+        int   *indices= table->indices, size= table->size, j;
+        table->size *= 2;
+        table->keys= calloc(table->size, sizeof(char *));
+        table->indices= calloc(table->size, sizeof(int));
+        for (j= 0;  j < size;  ++j)
+            if (keys[j])
+            {
+                for (i= hashString(keys[j]) & (table->size - 1);  table->keys[i];  i= (i + 1) & (table->size - 1));
+                table->keys[i]= keys[j];
+                table->indices[i]= indices[j];
+            }
+        free(keys);
+        free(indices);
+    }
+    return table->count - 1;
+}
+
+static int emit(int op, int arg)
+{
+    if (programSize == programCapacity)
+    {
+        programCapacity= programCapacity ? programCapacity * 2 : 1024;
+        program= realloc(program, sizeof(Instruction) * programCapacity);
+    }
+    program[programSize].op= op;
+    program[programSize].arg= arg;
+    program[programSize].text= 0;
+    return programSize++;
+}
+
+static void patch(int at)	{ program[at].arg= programSize; }
+
+static void Node_compile_vm(Node *node)
+{
+    assert(node);
+    switch (node->type)
+    {
+        case Rule:
+            fprintf(stderr, "\ninternal error #1 (%s)\n", node->rule.name);
+            exit(1);
+            break;
+
+        case Dot:
+            emit(OpDot, 0);
+            break;
+
+        case Name:
+            emit(OpCall, node->name.rule->rule.id);
+            if (node->name.variable)
+                emit(OpSet, -node->name.variable->variable.offset);
+            break;
+
+        case Character:
+        case String:
+            {
+                char *value= node->string.value;
+                int   len= strlen(value), letters;
+                if (String == node->type && (StringCaseless & node->string.flags))
+                {
+                    Buffer lower, mask;
+                    Buffer_init(&lower);
+                    Buffer_init(&mask);
+                    if ((letters= String_fold(&lower, &mask, &len, value)))
+                        emit(OpCaseless, Table_intern(&strings, lower.text));
+                    Buffer_release(&lower);
+                    Buffer_release(&mask);
+                    if (letters) break;
+                    len= strlen(value);
+                }
+                if (1 == len || (2 == len && '\\' == value[0]))
+                {
+                    Buffer text;
+                    Buffer_init(&text);
+                    Buffer_printf(&text, "'%s'", '\'' == value[0] && 1 == len ? "\\'" : value);
+                    program[emit(OpChar, 0)].text= text.text;
+                }
+                else
+                    emit(OpString, Table_intern(&strings, value));
+            }
+            break;
+
+        case Class:
+            {
+                Buffer bits;
+                Buffer_init(&bits);
+                Class_compile_c(&bits, node->cclass.value);
+                emit(OpClass, Table_intern(&classes, bits.text));
+                Buffer_release(&bits);
+            }
+            break;
+
+        case Action:
+            Buffer_printf(&actionTable, "  yy%s,\n", node->action.name);
+            emit(OpAction, actionCount++);
+            break;
+
+        case Predicate:
+            Buffer_printf(&predicates, "    case %d:  return (%s);\n", predicateCount, node->predicate.text);
+            emit(OpPredicate, predicateCount++);
+            break;
+
+        case Error:
+            {
+                int choice= emit(OpChoice, 0), commit;
+                Node_compile_vm(node->error.element);
+                commit= emit(OpCommit, 0);
+                patch(choice);
+                Buffer_printf(&errors, "    case %d:  {  YY_OFFSET yybegin YY_UNUSED= yy->__begin, yyend YY_UNUSED= yy->__end;\n", errorCount);
+                Buffer_printf(&errors, "  %s;\n", node->error.text);
+                Buffer_printf(&errors, "    }  break;\n");
+                emit(OpError, errorCount++);
+                emit(OpFail, 0);
+                patch(commit);
+            }
+            break;
+
+        case Alternate:
+            {
+                int *commits= malloc(sizeof(int) * 16), count= 0, size= 16, i;
+                for (node= node->alternate.first;  node;  node= node->alternate.next)
+                    if (node->alternate.next)
+                    {
+                        int choice= emit(OpChoice, 0);
+                        Node_compile_vm(node);
+                        if (count == size) commits= realloc(commits, sizeof(int) * (size *= 2));
+                        commits[count++]= emit(OpCommit, 0);
+                        patch(choice);
+                    }
+                    else
+                        Node_compile_vm(node);
+                for (i= 0;  i < count;  ++i)
+                    patch(commits[i]);
+                free(commits);
+            }
+            break;
+
+        case Sequence:
+            for (node= node->sequence.first;  node;  node= node->sequence.next)
+                Node_compile_vm(node);
+            break;
+
+        case PeekFor:
+            {
+                int choice= emit(OpChoice, 0), back;
+                Node_compile_vm(node->peekFor.element);
+                back= emit(OpBack, 0);
+                patch(choice);
+                emit(OpFail, 0);
+                patch(back);
+            }
+            break;
+
+        case PeekNot:
+            {
+                int choice= emit(OpChoice, 0);
+                Node_compile_vm(node->peekNot.element);
+                emit(OpFailTwice, 0);
+                patch(choice);
+            }
+            break;
+
+        case Query:
+            {
+                int choice= emit(OpChoice, 0), commit;
+                Node_compile_vm(node->query.element);
+                commit= emit(OpCommit, 0);
+                patch(choice);
+                patch(commit);
+            }
+            break;
+
+        case Star:
+        case Plus:
+            {
+                int choice, again;
+                if (Plus == node->type)
+                    Node_compile_vm(node->plus.element);
+                choice= emit(OpChoice, 0);
+                again= programSize;
+                Node_compile_vm(node->star.element);
+                emit(OpPartial, again);
+                patch(choice);
+            }
+            break;
+
+        default:
+            fprintf(stderr, "\nNode_compile_vm: illegal node type %d\n", node->type);
+            exit(1);
+    }
+}
+
+static int countVariables(Node *node)
+{
+    int count= 0;
+    for (;  node;  node= node->variable.next)
+        node->variable.offset= --count;
+    return -count;
+}
+
+static char *interpreter= "\
+typedef struct _yyframe { YY_OFFSET pos, begin, end;  int pc, thunkpos, frame, rule, call; } yyframe;\n\
+\n\
+YY_LOCAL(yyframe *) yypushframe(yycontext *yy, yyframe **frames, yyframe *stack, int *sp, int *len)\n\
+{\n\
+    if (++*sp == *len)\n\
+    {\n\
+        yyframe *bigger= (yyframe *)YY_MALLOC(yy, sizeof(yyframe) * *len * 2);\n\
+        memcpy(bigger, *frames, sizeof(yyframe) * *len);\n\
+        if (*frames != stack) YY_FREE(*frames);\n\
+        *frames= bigger;\n\
+        *len *= 2;\n\
+    }\n\
+    (*frames)[*sp].pos= yy->__pos;\n\
+    (*frames)[*sp].thunkpos= yy->__thunkpos;\n\
+    (*frames)[*sp].begin= yy->__begin;\n\
+    (*frames)[*sp].end= yy->__end;\n\
+    (*frames)[*sp].frame= yy->__frame;\n\
+    return *frames + *sp;\n\
+}\n\
+\n\
+/* Match a case-insensitive literal, given with its letters in lower case. */\n\
+YY_LOCAL(int) yymatchFolded(yycontext *yy, const char *s)\n\
+{\n\
+    YY_OFFSET yysav= yy->__pos;\n\
+    const char *yystr= s;\n\
+    for (;  *s;  ++s, ++yy->__pos)\n\
+    {\n\
+        int c;\n\
+        if (yy->__pos >= yy->__limit && !yyrefill(yy)) break;\n\
+        c= (unsigned char)yy->__buf[yy->__pos];\n\
+        if (('a' <= *s && *s <= 'z' ? c | 0x20 : c) != (unsigned char)*s) break;\n\
+    }\n\
+    if (!*s) return 1;\n\
+    yy->__pos= yysav;\n\
+    yyexpect(yy, YYEXPECT_STRING, 0, yystr);\n\
+    return 0;\n\
+}\n\
+\n\
+/* Run the program from the entry point of rule yyrule until that rule\n\
+ * returns (answering 1) or fails (answering 0, with the state restored).\n\
+ * Choice points and rule activations share one stack; a failure pops\n\
+ * activations until it finds a choice point to resume from.\n\
+ */\n\
+YY_LOCAL(int) yyexec(yycontext *yy, int yyrule)\n\
+{\n\
+    yyframe   yystack[YY_STACK_SIZE], *yyframes= yystack, *yyf;\n\
+    int       yysp= -1, yylen= YY_STACK_SIZE, yycall= 0, yypc= 0, yyok= 0;\n\
+    const yyinstr *yyop;\n\
+    goto yycallrule;\n\
+    for (;;)\n\
+    {\n\
+        yyop= yyprogram + yypc;\n\
+        switch (yyop[0])\n\
+        {\n\
+            case YYOP_DOT:		if (!yymatchDot(yy)) goto yyfail;  yypc += 1;  break;\n\
+            case YYOP_CHAR:		if (!yymatchChar(yy, yyop[1])) goto yyfail;  yypc += 2;  break;\n\
+            case YYOP_STRING:		if (!yymatchString(yy, yystrings[yyop[1]])) goto yyfail;  yypc += 2;  break;\n\
+            case YYOP_CASELESS:		if (!yymatchFolded(yy, yystrings[yyop[1]])) goto yyfail;  yypc += 2;  break;\n\
+            case YYOP_CLASS:		if (!yymatchClass(yy, (unsigned char *)yyclasses[yyop[1]])) goto yyfail;  yypc += 2;  break;\n\
+            case YYOP_CALL:\n\
+                yyrule= yyop[1];\n\
+                yypc += 2;\n\
+            yycallrule:\n\
+                yyf= yypushframe(yy, &yyframes, yystack, &yysp, &yylen);\n\
+                yyf->pc= yypc;  yyf->rule= yyrule;  yyf->call= yycall;\n\
+                yycall= yysp;\n\
+                yypc= yyrules[yyrule].entry;\n\
+                yyprintf((stderr, \"%s\\n\", yyrules[yyrule].name));\n\
+                (void)YY_BEGIN;\n\
+                if (YY_LIMITED(yy)) goto yyfail;\n\
+                break;\n\
+            case YYOP_RETURN:\n\
+                yyf= yyframes + yysp--;\n\
+                yyprintf((stderr, \"  ok   %s @ %s\\n\", yyrules[yyf->rule].name, yy->__buf+yy->__pos));\n\
+                yypc= yyf->pc;  yycall= yyf->call;\n\
+                if (yysp < 0) { yyok= 1;  goto yydone; }\n\
+                break;\n\
+            case YYOP_CHOICE:\n\
+                yyf= yypushframe(yy, &yyframes, yystack, &yysp, &yylen);\n\
+                yyf->pc= yypc + yyop[1];  yyf->rule= -1;  yyf->call= yycall;\n\
+                yypc += 2;\n\
+                break;\n\
+            case YYOP_COMMIT:		--yysp;  yypc += yyop[1];  break;\n\
+            case YYOP_PARTIAL:\n\
+                yyf= yyframes + yysp;\n\
+                yyf->pos= yy->__pos;  yyf->thunkpos= yy->__thunkpos;  yyf->begin= yy->__begin;  yyf->end= yy->__end;  yyf->frame= yy->__frame;\n\
+                yypc += yyop[1];\n\
+                break;\n\
+            case YYOP_BACK:\n\
+                yyf= yyframes + yysp--;\n\
+                yy->__pos= yyf->pos;  yy->__thunkpos= yyf->thunkpos;  yy->__begin= yyf->begin;  yy->__end= yyf->end;  yy->__frame= yyf->frame;\n\
+                yypc += yyop[1];\n\
+                break;\n\
+            case YYOP_FAILTWICE:	--yysp;  goto yyfail;\n\
+            case YYOP_FAIL:		goto yyfail;\n\
+            case YYOP_JUMP:		yypc += yyop[1];  break;\n\
+            case YYOP_ACTION:		(void)YY_END;  yyDo(yy, yyactions[yyop[1]], yyframes[yycall].pos, yy->__end);  yypc += 2;  break;\n\
+            case YYOP_PREDICATE:	if (!yypredicate(yy, yyop[1], yyframes[yycall].thunkpos)) goto yyfail;  yypc += 2;  break;\n\
+            case YYOP_ERROR:		if (!yy->__expecting) yyerrors(yy, yyop[1]);  yypc += 2;  break;\n\
+            case YYOP_PUSH:		if (!yyFrame(yy, yyop[1])) goto yyfail;  yypc += 2;  break;\n\
+            case YYOP_POP:		yy->__frame -= yyop[1];  yypc += 2;  break;\n\
+            case YYOP_SET:		yyDo(yy, yySet, -yyop[1], 0);  yypc += 2;  break;\n\
+        }\n\
+        continue;\n\
+    yyfail:\n\
+        for (;;)\n\
+        {\n\
+            yyf= yyframes + yysp--;\n\
+            yy->__pos= yyf->pos;  yy->__thunkpos= yyf->thunkpos;  yy->__begin= yyf->begin;  yy->__end= yyf->end;  yy->__frame= yyf->frame;\n\
+            if (yyf->rule < 0) break;\n\
+            yyprintf((stderr, \"  fail %s @ %s\\n\", yyrules[yyf->rule].name, yy->__buf+yy->__pos));\n\
+            if (yysp < 0) goto yydone;\n\
+        }\n\
+        yypc= yyf->pc;  yycall= yyf->call;\n\
+    }\n\
+  yydone:\n\
+    if (yyframes != yystack) YY_FREE(yyframes);\n\
+    return yyok;\n\
+}\n\
+\n\
+";
+
+static int *layoutProgram(void)
+{
+    int *address= malloc(sizeof(int) * (programSize + 1)), pc= 0, i;
+    for (i= 0;  i < programSize;  ++i)
+    {
+        address[i]= pc;
+        pc += 1 + opOperands[program[i].op];
+    }
+    address[programSize]= pc;
+    return address;
+}
+
+/* Jumps are relative to the instruction, so that the operands of most
+ * programs fit in a short whatever the size of the grammar.
+ */
+static int operand(Instruction *insn, int *address)
+{
+    return opIsJump(insn->op) ? address[insn->arg] - address[insn - program] : insn->arg;
+}
+
+static void writeProgram(int *address)
+{
+    char *type= "short";
+    int   i;
+    for (i= 0;  i < programSize;  ++i)
+        if (opOperands[program[i].op] && !program[i].text)
+        {
+            int arg= operand(&program[i], address);
+            if (arg < -32768 || arg > 32767) type= "int";
+        }
+    fprintf(output, "typedef %s yyinstr;\n\n", type);
+    fprintf(output, "static const yyinstr yyprogram[%d]= {\n", address[programSize]);
+    for (i= 0;  i < programSize;  ++i)
+    {
+        Instruction *insn= &program[i];
+        fprintf(output, "  /* %5d */ %s,", address[i], opNames[insn->op]);
+        if (insn->text)
+            fprintf(output, " %s,", insn->text);
+        else if (opOperands[insn->op])
+            fprintf(output, " %d,", operand(insn, address));
+        fprintf(output, "\n");
+    }
+    fprintf(output, "};\n\n");
+}
+
+void Rule_compile_vm(Node *node)
+{
+    int  *entry= calloc(ruleCount + 1, sizeof(int)), *address;
+    Node **byId= calloc(ruleCount + 1, sizeof(Node *));
+    Node *n;
+    int   i;
+
+    for (n= rules;  n;  n= n->rule.next)
+        consumesInput(n);
+
+    programSize= predicateCount= errorCount= actionCount= 0;
+    Table_init(&strings);
+    Table_init(&classes);
+    Buffer_init(&predicates);
+    Buffer_init(&errors);
+    Buffer_init(&actionTable);
+
+    /* Instruction 0 fails, and is the entry point of undefined rules. */
+    emit(OpFail, 0);
+    for (n= node;  n;  n= n->rule.next)
+    {
+        if (!n->rule.expression)
+        {
+            fprintf(stderr, "rule '%s' used but not defined\n", n->rule.name);
+            continue;
+        }
+        if ((!(RuleUsed & n->rule.flags)) && (n != start))
+            fprintf(stderr, "rule '%s' defined but not used\n", n->rule.name);
+        byId[n->rule.id]= n;
+        entry[n->rule.id]= programSize;
+        if (n->rule.variables)
+            emit(OpPush, countVariables(n->rule.variables));
+        Node_compile_vm(n->rule.expression);
+        if (n->rule.variables)
+            emit(OpPop, countVariables(n->rule.variables));
+        emit(OpReturn, 0);
+    }
+
+    Rule_compile_c_preamble();
+    fprintf(output, "enum {");
+    for (i= 0;  i < OpCount;  ++i)
+        fprintf(output, "%s %s", i ? "," : "", opNames[i]);
+    fprintf(output, " };\n\n");
+    for (n= node;  n;  n= n->rule.next)
+        fprintf(output, "YY_UNUSED YY_RULE(int) yy_%s(yycontext *yy); /* %d */\n", n->rule.name, n->rule.id);
+    fprintf(output, "\n");
+    for (n= actions;  n;  n= n->action.list)
+        Action_compile_c(n);
+
+    fprintf(output, "\nstatic yyaction yyactions[%d]= {\n%s  0\n};\n\n", actionCount + 1, actionTable.text);
+    fprintf(output, "static const char *yystrings[%d]= {\n%s  0\n};\n\n", strings.count + 1, strings.text.text);
+    fprintf(output, "static const char *yyclasses[%d]= {\n%s  0\n};\n\n", classes.count + 1, classes.text.text);
+    fprintf(output, "static const struct { int entry;  const char *name; } yyrules[%d]= {\n  { 0, 0 },\n", ruleCount + 1);
+    address= layoutProgram();
+    for (i= 1;  i <= ruleCount;  ++i)
+        fprintf(output, "  { %d, \"%s\" },\n", address[entry[i]], byId[i] ? byId[i]->rule.name : "");
+    fprintf(output, "};\n\n");
+    writeProgram(address);
+
+    fprintf(output, "YY_LOCAL(int) yypredicate(yycontext *yy, int yyn, int yythunkpos0)\n{\n  switch (yyn)\n  {\n%s  }\n  return 0;\n}\n\n", predicates.text);
+    fprintf(output, "YY_LOCAL(void) yyerrors(yycontext *yy, int yyn)\n{\n  switch (yyn)\n  {\n%s  }\n}\n\n", errors.text);
+    fprintf(output, "%s", interpreter);
+    for (n= node;  n;  n= n->rule.next)
+        fprintf(output, "YY_RULE(int) yy_%s(yycontext *yy) { return yyexec(yy, %d); }\n", n->rule.name, n->rule.id);
+
+    Table_release(&strings);
+    Table_release(&classes);
+    Buffer_release(&predicates);
+    Buffer_release(&errors);
+    Buffer_release(&actionTable);
+    for (i= 0;  i < programSize;  ++i)
+        free(program[i].text);
+    free(address);
+    free(entry);
+    free(byId);
+    Rule_compile_c_footer();
+}
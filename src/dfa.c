@@ -0,0 +1,480 @@
+/* Copyright (c) 2007, 2012 by Ian Piumarta
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the 'Software'),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, provided that the above copyright notice(s) and this
+ * permission notice appear in all copies of the Software.  Acknowledgement
+ * of the use of this Software in supporting documentation would be
+ * appreciated but is not required.
+ *
+ * THE SOFTWARE IS PROVIDED 'AS IS'.  USE ENTIRELY AT YOUR OWN RISK.
+ */
+
+/* Token rules (see Rule_compile_c_token() in compile.c) that are regular
+ * are compiled into deterministic automata.
+ *
+ * Ordered choice and greedy repetition agree with a deterministic
+ * automaton only when no decision is ever undone.  A rule qualifies
+ * when:
+ *
+ *   - it consists of single-byte matches, literals, sequences,
+ *     alternatives, repetitions and calls to other such tokens, with
+ *     '!s t' and '&s t' (where s and t match one byte each) standing
+ *     for a single byte;
+ *   - the alternatives of each choice are non-empty and start with
+ *     distinct bytes, so the next byte picks one;
+ *   - the element of each '*', '+' and '?' is non-empty and cannot fail
+ *     once it has matched its first byte, so entering it is final.
+ *
+ * A failure after a decision is then a failure of the whole rule for
+ * the backtracking parser too.  Positions (single-byte matches) are
+ * numbered and linked to the positions that can follow them, in order
+ * of preference: a repetition prefers another round to what comes
+ * after it.  Each position is a state of the automaton, which runs
+ * until no transition applies and succeeds if it stopped in a state
+ * that ends the rule.  The minimized automaton is emitted as a label
+ * per state and a test per transition, so each byte costs one branch
+ * (or a few, where a state has several successors) and nothing is ever
+ * matched twice.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "tree.h"
+
+#define DFA_MAXPOS	250		/* state numbers fit in an unsigned char */
+
+typedef struct List {
+    int count;
+    int items[DFA_MAXPOS];
+} List;
+
+typedef struct Frag {
+    int	 nullable;
+    List first;
+    List last;
+} Frag;
+
+typedef struct Dfa {
+    int		  count;			/* positions */
+    unsigned char bits[DFA_MAXPOS][32];		/* the bytes each position matches */
+    List	  follow[DFA_MAXPOS];
+} Dfa;
+
+static inline int  hasBit(unsigned char *bits, int c)	{ return bits[c >> 3] & (1 << (c & 7)); }
+static inline void setBit(unsigned char *bits, int c)	{ bits[c >> 3] |= (1 << (c & 7)); }
+
+/* Set the byte c that node, a literal, matches and, if node ignores case,
+ * the same letter in the other case.
+ */
+static void setLiteralBit(Node *node, unsigned char *bits, int c)
+{
+    setBit(bits, c);
+    if (String == node->type && (StringCaseless & node->string.flags) && c < 128 && isalpha(c))
+        setBit(bits, c ^ 0x20);
+}
+
+static void List_add(List *list, int p)
+{
+    int i;
+    for (i= 0;  i < list->count;  ++i)
+        if (p == list->items[i]) return;
+    list->items[list->count++]= p;
+}
+
+static void List_addAll(List *list, List *other)
+{
+    int i;
+    for (i= 0;  i < other->count;  ++i)
+        List_add(list, other->items[i]);
+}
+
+/* Answer whether node always matches exactly one byte, setting bits to
+ * the bytes it matches.
+ */
+static int byteSet(Node *node, unsigned char bits[32])
+{
+    unsigned char *text, more[32];
+    int		   c;
+
+    switch (node->type)
+    {
+        case Dot:
+            memset(bits, 255, 32);
+            return 1;
+
+        case Character:
+        case String:
+            text= (unsigned char *)node->string.value;
+            c= Char_next(&text);
+            if (!c || *text) return 0;
+            memset(bits, 0, 32);
+            setLiteralBit(node, bits, c);
+            return 1;
+
+        case Class:
+            Class_bits(bits, node->cclass.value);
+            return 1;
+
+        case Alternate:
+            memset(bits, 0, 32);
+            for (node= node->alternate.first;  node;  node= node->alternate.next)
+            {
+                if (!byteSet(node, more)) return 0;
+                for (c= 0;  c < 32;  ++c) bits[c] |= more[c];
+            }
+            return 1;
+
+        case Name:
+            return (RuleToken & node->name.rule->rule.flags) && !node->name.variable && byteSet(node->name.rule->rule.expression, bits);
+    }
+    return 0;
+}
+
+/* Answer whether node, a predicate, and next together match one byte. */
+static int peekSet(Node *node, Node *next, unsigned char bits[32])
+{
+    unsigned char peek[32];
+    int		  c;
+
+    if ((PeekFor != node->type && PeekNot != node->type) || !next)
+        return 0;
+    if (!byteSet(node->peekFor.element, peek) || !byteSet(next, bits))
+        return 0;
+    for (c= 0;  c < 32;  ++c)
+        bits[c] &= (PeekFor == node->type) ? peek[c] : ~peek[c];
+    return 1;
+}
+
+static int neverFails(Node *node);
+
+/* Answer whether node is non-empty and, once it has matched its first
+ * byte, always succeeds.
+ */
+static int commitSafe(Node *node)
+{
+    unsigned char bits[32];
+
+    if (byteSet(node, bits))
+        return 1;
+    switch (node->type)
+    {
+        case Sequence:
+            node= node->sequence.first;
+            if (!node) return 0;
+            if (peekSet(node, node->sequence.next, bits))
+                node= node->sequence.next;
+            else if (!commitSafe(node))
+                return 0;
+            for (node= node->sequence.next;  node;  node= node->sequence.next)
+                if (!neverFails(node)) return 0;
+            return 1;
+
+        case Alternate:
+            for (node= node->alternate.first;  node;  node= node->alternate.next)
+                if (!commitSafe(node)) return 0;
+            return 1;
+
+        case Plus:
+            return commitSafe(node->plus.element);
+
+        case Name:
+            return (RuleToken & node->name.rule->rule.flags) && !node->name.variable && commitSafe(node->name.rule->rule.expression);
+    }
+    return 0;
+}
+
+static int neverFails(Node *node)
+{
+    switch (node->type)
+    {
+        case Query:
+        case Star:
+            return 1;
+
+        case Sequence:
+            for (node= node->sequence.first;  node;  node= node->sequence.next)
+                if (!neverFails(node)) return 0;
+            return 1;
+
+        case String:
+            return !*node->string.value;
+
+        case Name:
+            return (RuleToken & node->name.rule->rule.flags) && !node->name.variable && neverFails(node->name.rule->rule.expression);
+    }
+    return 0;
+}
+
+static int Dfa_position(Dfa *dfa, unsigned char bits[32], Frag *frag)
+{
+    int p= dfa->count;
+    if (DFA_MAXPOS == p) return 0;
+    ++dfa->count;
+    memcpy(dfa->bits[p], bits, 32);
+    dfa->follow[p].count= 0;
+    frag->nullable= 0;
+    frag->first.count= frag->last.count= 0;
+    List_add(&frag->first, p);
+    List_add(&frag->last, p);
+    return 1;
+}
+
+/* Append b to a, preferring whatever a can do next to the start of b. */
+static void Dfa_concat(Dfa *dfa, Frag *a, Frag *b)
+{
+    int i;
+    for (i= 0;  i < a->last.count;  ++i)
+        List_addAll(&dfa->follow[a->last.items[i]], &b->first);
+    if (a->nullable)
+        List_addAll(&a->first, &b->first);
+    if (b->nullable)
+        List_addAll(&b->last, &a->last);
+    a->last= b->last;
+    a->nullable= a->nullable && b->nullable;
+}
+
+static int Node_dfa(Dfa *dfa, Node *node, Frag *frag)
+{
+    unsigned char bits[32];
+    Frag	 *part;
+    int		  i, ok;
+
+    if (byteSet(node, bits))
+        return Dfa_position(dfa, bits, frag);
+
+    switch (node->type)
+    {
+        case String:
+            {
+                unsigned char *text= (unsigned char *)node->string.value;
+                frag->nullable= 1;
+                frag->first.count= frag->last.count= 0;
+                part= malloc(sizeof(Frag));
+                for (ok= 1;  ok && *text;  )
+                {
+                    memset(bits, 0, 32);
+                    setLiteralBit(node, bits, Char_next(&text));
+                    if ((ok= Dfa_position(dfa, bits, part)))
+                        Dfa_concat(dfa, frag, part);
+                }
+                free(part);
+                return ok;
+            }
+
+        case Sequence:
+            frag->nullable= 1;
+            frag->first.count= frag->last.count= 0;
+            part= malloc(sizeof(Frag));
+            for (ok= 1, node= node->sequence.first;  ok && node;  node= node->sequence.next)
+            {
+                if (peekSet(node, node->sequence.next, bits))
+                {
+                    node= node->sequence.next;
+                    ok= Dfa_position(dfa, bits, part);
+                }
+                else
+                    ok= Node_dfa(dfa, node, part);
+                if (ok)
+                    Dfa_concat(dfa, frag, part);
+            }
+            free(part);
+            return ok;
+
+        case Alternate:
+            {
+                unsigned char seen[32];
+                memset(seen, 0, 32);
+                frag->nullable= 0;
+                frag->first.count= frag->last.count= 0;
+                part= malloc(sizeof(Frag));
+                for (ok= 1, node= node->alternate.first;  ok && node;  node= node->alternate.next)
+                {
+                    if (!(ok= Node_dfa(dfa, node, part) && !part->nullable))
+                        break;
+                    for (i= 0;  ok && i < part->first.count;  ++i)
+                    {
+                        int c;
+                        for (c= 0;  c < 32;  ++c)
+                        {
+                            if (seen[c] & dfa->bits[part->first.items[i]][c])
+                                ok= 0;
+                            seen[c] |= dfa->bits[part->first.items[i]][c];
+                        }
+                    }
+                    List_addAll(&frag->first, &part->first);
+                    List_addAll(&frag->last, &part->last);
+                }
+                free(part);
+                return ok;
+            }
+
+        case Star:
+        case Plus:
+        case Query:
+            if (!commitSafe(node->query.element) || !Node_dfa(dfa, node->query.element, frag) || frag->nullable)
+                return 0;
+            if (Query != node->type)
+                for (i= 0;  i < frag->last.count;  ++i)
+                    List_addAll(&dfa->follow[frag->last.items[i]], &frag->first);
+            frag->nullable= (Plus != node->type);
+            return 1;
+
+        case Name:
+            if (!(RuleToken & node->name.rule->rule.flags) || node->name.variable)
+                return 0;
+            return Node_dfa(dfa, node->name.rule->rule.expression, frag);
+    }
+    return 0;
+}
+
+/* Compile rule into an automaton yyscan_<rule>() if it is
+ * regular, answering whether it was.  Rules that match a single byte
+ * are left to the ordinary scanner, which tests it directly.
+ */
+int Rule_compile_dfa(Buffer *buf, Node *rule)
+{
+    Dfa		  *dfa= malloc(sizeof(Dfa));
+    Frag	  *root= malloc(sizeof(Frag));
+    int		   states, count, blocks, s, t, c, i, rejects;
+    unsigned char *delta, *accept, *block, *next, *order, *number, *entered, bits[32];
+
+    dfa->count= 0;
+    if (byteSet(rule->rule.expression, bits) || !Node_dfa(dfa, rule->rule.expression, root))
+    {
+        free(dfa);
+        free(root);
+        return 0;
+    }
+
+    /* State 0 is dead, 1 is the start and 2 + p follows position p. */
+    states= dfa->count + 2;
+    delta=  calloc(states, 256);
+    accept= calloc(states, 1);
+    block=  calloc(states, 1);
+    next=   calloc(states, 1);
+    order=  calloc(states, 1);
+    number= calloc(states, 1);
+    entered= calloc(states, 1);
+    accept[1]= root->nullable;
+    for (i= 0;  i < root->last.count;  ++i)
+        accept[root->last.items[i] + 2]= 1;
+    for (s= 1;  s < states;  ++s)
+    {
+        List *follow= (1 == s) ? &root->first : &dfa->follow[s - 2];
+        for (c= 0;  c < 256;  ++c)
+            for (i= 0;  i < follow->count;  ++i)
+                if (hasBit(dfa->bits[follow->items[i]], c))
+                {
+                    delta[s * 256 + c]= follow->items[i] + 2;
+                    break;
+                }
+    }
+
+    /* Merge equivalent states, keeping the dead state to itself so that
+     * the automaton stops exactly where the parser would.
+     */
+    for (s= 0;  s < states;  ++s)
+        block[s]= s ? 1 + accept[s] : 0;
+    for (count= -1;  ;  count= blocks)
+    {
+        for (blocks= 0, s= 0;  s < states;  ++s)
+        {
+            for (i= 0;  i < blocks;  ++i)
+            {
+                int r= order[i];
+                if (block[r] != block[s]) continue;
+                for (c= 0;  c < 256 && block[delta[r * 256 + c]] == block[delta[s * 256 + c]];  ++c);
+                if (256 == c) break;
+            }
+            if (i == blocks) order[blocks++]= s;
+            next[s]= i;
+        }
+        memcpy(block, next, states);
+        if (blocks == count) break;
+    }
+
+    /* Number the blocks reachable from the start, dead first. */
+    memset(number, 255, states);
+    number[block[0]]= 0;
+    number[block[1]]= 1;
+    order[0]= 0;
+    order[1]= 1;
+    for (count= 2, i= 1;  i < count;  ++i)
+        for (c= 0;  c < 256;  ++c)
+        {
+            t= block[delta[order[i] * 256 + c]];
+            if (255 == number[t])
+            {
+                number[t]= count;
+                for (s= 0;  block[s] != t;  ++s);
+                order[count++]= s;
+            }
+        }
+
+    /* Only states that some transition enters need a label, and the
+     * failure exit only if some state is not final.
+     */
+    for (rejects= 0, i= 1;  i < count;  ++i)
+    {
+        for (c= 0;  c < 256;  ++c)
+            entered[number[block[delta[order[i] * 256 + c]]]]= 1;
+        if (!accept[order[i]]) rejects= 1;
+    }
+
+    /* Each state is a label.  It reads a byte and tests it against the
+     * set of bytes leading to each of its successors in turn; when none
+     * applies the rule has ended, successfully if the state is final.
+     */
+    Buffer_printf(buf, "\nYY_RULE(YY_OFFSET) yyscan_%s(yycontext *yy, YY_OFFSET yyp0)\n{", rule->rule.name);
+    Buffer_printf(buf, rejects ? "  YY_OFFSET yyp= yyp0, yybegin0= yy->__begin;  int yyc;" : "  YY_OFFSET yyp= yyp0;  int yyc;");
+    Buffer_printf(buf, "\n  yy->__begin= yyp;");
+    for (i= 1;  i < count;  ++i)
+    {
+        int live= 0;
+        if (entered[i])
+            Buffer_printf(buf, "\n  l%d:;", i);
+        for (t= 1;  t < count;  ++t)
+        {
+            memset(bits, 0, 32);
+            for (c= 0;  c < 256;  ++c)
+                if (number[block[delta[order[i] * 256 + c]]] == t)
+                    setBit(bits, c);
+            for (c= 0;  c < 32 && !bits[c];  ++c);
+            if (32 == c) continue;
+            if (!live++)
+                Buffer_printf(buf, "\n  if (yyp >= yy->__limit && !yyrefill(yy)) goto e%d;\n  yyc= (unsigned char)yy->__buf[yyp];", i);
+            Buffer_printf(buf, "\n  if (yyinclass((unsigned char *)\"");
+            for (c= 0;  c < 32;  ++c)
+                Buffer_printf(buf, "\\%03o", bits[c]);
+            Buffer_printf(buf, "\", yyc)) { ++yyp;  goto l%d; }", t);
+        }
+        if (live)
+            Buffer_printf(buf, "\n  e%d:;", i);
+        Buffer_printf(buf, accept[order[i]] ? "  return yyp - yyp0;" : "  goto l0;");
+    }
+    if (rejects)
+    {
+        Buffer_printf(buf, "\n  l0:;  yy->__begin= yybegin0;");
+        Buffer_printf(buf, "\n  return -1;");
+    }
+    Buffer_printf(buf, "\n}");
+
+    free(delta);
+    free(accept);
+    free(block);
+    free(next);
+    free(order);
+    free(number);
+    free(entered);
+    free(dfa);
+    free(root);
+    return 1;
+}
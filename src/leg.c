@@ -353,6 +353,19 @@ YY_RULE(int) yy_declaration(yycontext *yy); /* 3 */
 YY_RULE(int) yy__(yycontext *yy); /* 2 */
 YY_RULE(int) yy_grammar(yycontext *yy); /* 1 */
 
+YY_ACTION(void) yy_10_primary(yycontext *yy, char *yytext, int yyleng)
+{
+#define __ yy->__
+#define yypos yy->__pos
+#define yythunkpos yy->__thunkpos
+  yyprintf((stderr, "do yy_10_primary\n"));
+  {
+   String_beCaseless(top()); ;
+  }
+#undef yythunkpos
+#undef yypos
+#undef yy
+}
 YY_ACTION(void) yy_9_primary(yycontext *yy, char *yytext, int yyleng)
 {
 #define __ yy->__
@@ -721,7 +734,7 @@ YY_RULE(int) yy_range(yycontext *yy)
 YY_RULE(int) yy_char(yycontext *yy)
 {  int yypos0= yy->__pos, yythunkpos0= yy->__thunkpos;
   yyprintf((stderr, "%s\n", "char"));
-  {  int yypos23= yy->__pos, yythunkpos23= yy->__thunkpos;  if (!yymatchChar(yy, '\\')) goto l24;  if (!yymatchClass(yy, (unsigned char *)"\000\000\000\000\204\040\000\000\000\000\000\070\146\100\124\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000")) goto l24;  goto l23;
+  {  int yypos23= yy->__pos, yythunkpos23= yy->__thunkpos;  if (!yymatchChar(yy, '\\')) goto l24;  if (!yymatchClass(yy, (unsigned char *)"\000\000\000\000\204\040\000\000\000\000\001\070\146\100\165\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000")) goto l24;  goto l23;
   l24:;	  yy->__pos= yypos23; yy->__thunkpos= yythunkpos23;  if (!yymatchChar(yy, '\\')) goto l25;  if (!yymatchClass(yy, (unsigned char *)"\000\000\000\000\000\000\017\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000")) goto l25;  if (!yymatchClass(yy, (unsigned char *)"\000\000\000\000\000\000\377\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000")) goto l25;  if (!yymatchClass(yy, (unsigned char *)"\000\000\000\000\000\000\377\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000")) goto l25;  goto l23;
   l25:;	  yy->__pos= yypos23; yy->__thunkpos= yythunkpos23;  if (!yymatchChar(yy, '\\')) goto l26;  if (!yymatchClass(yy, (unsigned char *)"\000\000\000\000\000\000\377\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000")) goto l26;
   {  int yypos27= yy->__pos, yythunkpos27= yy->__thunkpos;  if (!yymatchClass(yy, (unsigned char *)"\000\000\000\000\000\000\377\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000")) goto l27;  goto l28;
@@ -793,7 +806,7 @@ YY_RULE(int) yy_literal(yycontext *yy)
   l42:;	  yy->__pos= yypos42; yy->__thunkpos= yythunkpos42;
   }  if (!yy_char(yy)) goto l41;  goto l40;
   l41:;	  yy->__pos= yypos41; yy->__thunkpos= yythunkpos41;
-  }  yyText(yy, yy->__begin, yy->__end);  if (!(YY_END)) goto l39;  if (!yymatchClass(yy, (unsigned char *)"\000\000\000\000\200\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000")) goto l39;  if (!yy__(yy)) goto l39;  goto l38;
+  }  yyText(yy, yy->__begin, yy->__end);  if (!(YY_END)) goto l39;  if (!yymatchClass(yy, (unsigned char *)"\000\000\000\000\200\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000")) goto l39;  goto l38;
   l39:;	  yy->__pos= yypos38; yy->__thunkpos= yythunkpos38;  if (!yymatchClass(yy, (unsigned char *)"\000\000\000\000\004\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000")) goto l37;  yyText(yy, yy->__begin, yy->__end);  if (!(YY_BEGIN)) goto l37;
   l43:;	
   {  int yypos44= yy->__pos, yythunkpos44= yy->__thunkpos;
@@ -801,7 +814,7 @@ YY_RULE(int) yy_literal(yycontext *yy)
   l45:;	  yy->__pos= yypos45; yy->__thunkpos= yythunkpos45;
   }  if (!yy_char(yy)) goto l44;  goto l43;
   l44:;	  yy->__pos= yypos44; yy->__thunkpos= yythunkpos44;
-  }  yyText(yy, yy->__begin, yy->__end);  if (!(YY_END)) goto l37;  if (!yymatchClass(yy, (unsigned char *)"\000\000\000\000\004\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000")) goto l37;  if (!yy__(yy)) goto l37;
+  }  yyText(yy, yy->__begin, yy->__end);  if (!(YY_END)) goto l37;  if (!yymatchClass(yy, (unsigned char *)"\000\000\000\000\004\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000")) goto l37;
   }
   l38:;	
   yyprintf((stderr, "  ok   %s @ %s\n", "literal", yy->__buf+yy->__pos));
@@ -876,7 +889,14 @@ YY_RULE(int) yy_primary(yycontext *yy)
   l57:;	  yy->__pos= yypos57; yy->__thunkpos= yythunkpos57;
   }  yyDo(yy, yy_3_primary, yy->__begin, yy->__end);  goto l53;
   l56:;	  yy->__pos= yypos53; yy->__thunkpos= yythunkpos53;  if (!yy_OPEN(yy)) goto l58;  if (!yy_expression(yy)) goto l58;  if (!yy_CLOSE(yy)) goto l58;  goto l53;
-  l58:;	  yy->__pos= yypos53; yy->__thunkpos= yythunkpos53;  if (!yy_literal(yy)) goto l59;  yyDo(yy, yy_4_primary, yy->__begin, yy->__end);  goto l53;
+  l58:;	  yy->__pos= yypos53; yy->__thunkpos= yythunkpos53;  if (!yy_literal(yy)) goto l59;  yyDo(yy, yy_4_primary, yy->__begin, yy->__end);
+  {  int yypos123= yy->__pos, yythunkpos123= yy->__thunkpos;  if (!yymatchChar(yy, 'i')) goto l123;
+  {  int yypos125= yy->__pos, yythunkpos125= yy->__thunkpos;  if (!yymatchClass(yy, (unsigned char *)"\000\000\000\000\000\040\377\003\376\377\377\207\376\377\377\007\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000")) goto l125;  goto l123;
+  l125:;	  yy->__pos= yypos125; yy->__thunkpos= yythunkpos125;
+  }  yyDo(yy, yy_10_primary, yy->__begin, yy->__end);  goto l124;
+  l123:;	  yy->__pos= yypos123; yy->__thunkpos= yythunkpos123;
+  }
+  l124:;	  if (!yy__(yy)) goto l59;  goto l53;
   l59:;	  yy->__pos= yypos53; yy->__thunkpos= yythunkpos53;  if (!yy_class(yy)) goto l60;  yyDo(yy, yy_5_primary, yy->__begin, yy->__end);  goto l53;
   l60:;	  yy->__pos= yypos53; yy->__thunkpos= yythunkpos53;  if (!yy_DOT(yy)) goto l61;  yyDo(yy, yy_6_primary, yy->__begin, yy->__end);  goto l53;
   l61:;	  yy->__pos= yypos53; yy->__thunkpos= yythunkpos53;  if (!yy_action(yy)) goto l62;  yyDo(yy, yy_7_primary, yy->__begin, yy->__end);  goto l53;
@@ -1229,9 +1249,12 @@ void makeHeader(char *text)
 
 void makeTrailer(char *text)
 {
+  free(trailer);
   trailer= strdup(text);
 }
 
+#ifndef PEG_LIBRARY
+
 static void version(char *name)
 {
   printf("%s version %d.%d.%d\n", name, PEG_MAJOR, PEG_MINOR, PEG_LEVEL);
@@ -1242,8 +1265,14 @@ static void usage(char *name)
   version(name);
   fprintf(stderr, "usage: %s [<option>...] [<file>...]\n", name);
   fprintf(stderr, "where <option> can be\n");
+  fprintf(stderr, "  -b          generate a compact bytecode parser\n");
+  fprintf(stderr, "  -c <cfile>  reuse code for unchanged rules cached in <cfile>\n");
   fprintf(stderr, "  -h          print this help information\n");
+  fprintf(stderr, "  -j <n>      split the output into a header, <ofile> and <n> rule files\n");
   fprintf(stderr, "  -o <ofile>  write output to <ofile>\n");
+  fprintf(stderr, "  -p <pfile>  place code using rule counts from a profile in <pfile>\n");
+  fprintf(stderr, "  -t          generate a parser that builds a parse tree\n");
+  fprintf(stderr, "  -T <n>      generate code for rules using <n> threads\n");
   fprintf(stderr, "  -v          be verbose\n");
   fprintf(stderr, "  -V          print version number and exit\n");
   fprintf(stderr, "if no <file> is given, input is read from stdin\n");
@@ -1255,13 +1284,15 @@ int main(int argc, char **argv)
 {
   Node *n;
   int   c;
+  char *outputName= 0;
+  int   bytecodeFlag= 0;
 
   output= stdout;
   input= stdin;
   lineNumber= 1;
   fileName= "<stdin>";
 
-  while (-1 != (c= getopt(argc, argv, "Vho:v")))
+  while (-1 != (c= getopt(argc, argv, "Vbc:hj:T:o:p:tv")))
     {
       switch (c)
 	{
@@ -1269,18 +1300,46 @@ int main(int argc, char **argv)
 	  version(basename(argv[0]));
 	  exit(0);
 
+	case 'b':
+	  bytecodeFlag= 1;
+	  break;
+
+	case 'c':
+	  cacheName= optarg;
+	  break;
+
 	case 'h':
 	  usage(basename(argv[0]));
 	  break;
 
-	case 'o':
-	  if (!(output= fopen(optarg, "w")))
+	case 'j':
+	  if ((splitCount= atoi(optarg)) < 1)
 	    {
-	      perror(optarg);
+	      fprintf(stderr, "%s: number of rule files must be positive\n", optarg);
 	      exit(1);
 	    }
 	  break;
 
+	case 'T':
+	  if ((threadCount= atoi(optarg)) < 1)
+	    {
+	      fprintf(stderr, "%s: number of threads must be positive\n", optarg);
+	      exit(1);
+	    }
+	  break;
+
+	case 'o':
+	  outputName= optarg;
+	  break;
+
+	case 'p':
+	  profileName= optarg;
+	  break;
+
+	case 't':
+	  parseTree= 1;
+	  break;
+
 	case 'v':
 	  verboseFlag= 1;
 	  break;
@@ -1290,9 +1349,22 @@ int main(int argc, char **argv)
 	  exit(1);
 	}
     }
+  if (splitCount && (!outputName || bytecodeFlag))
+    {
+      fprintf(stderr, "%s: -j requires -o and cannot be used with -b\n", argv[0]);
+      exit(1);
+    }
+  if (parseTree && bytecodeFlag)
+    {
+      fprintf(stderr, "%s: -t cannot be used with -b\n", argv[0]);
+      exit(1);
+    }
   argc -= optind;
   argv += optind;
 
+  if (outputName)
+    output= openOutput(splitCount ? Rule_compile_c_split(outputName) : outputName);
+
   if (argc)
     {
       for (;  argc;  --argc, ++argv)
@@ -1332,11 +1404,20 @@ int main(int argc, char **argv)
     fprintf(output, "%s\n", headers->text);
 
   if (rules)
-    Rule_compile_c(rules);
+    {
+      if (bytecodeFlag)
+	Rule_compile_vm(rules);
+      else
+	Rule_compile_c(rules);
+    }
 
   if (trailer)
     fprintf(output, "%s\n", trailer);
 
+  if (output != stdout)
+    closeOutput(output);
+
   return 0;
 }
 
+#endif /* PEG_LIBRARY */
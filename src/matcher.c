@@ -0,0 +1,542 @@
+/* Copyright (c) 2007, 2012 by Ian Piumarta
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the 'Software'),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, provided that the above copyright notice(s) and this
+ * permission notice appear in all copies of the Software.  Acknowledgement
+ * of the use of this Software in supporting documentation would be
+ * appreciated but is not required.
+ *
+ * THE SOFTWARE IS PROVIDED 'AS IS'.  USE ENTIRELY AT YOUR OWN RISK.
+ */
+
+/* Runtime grammar interpreter: reads a grammar with the same readers as
+ * leg and peg and matches text by walking the rule graph.  Everything
+ * that does not depend on the input (class bitmaps, decoded strings,
+ * the rule called by each name) is worked out once when the grammar is
+ * loaded and kept in a table indexed by node.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <assert.h>
+
+#include "tree.h"
+#include "matcher.h"
+
+/* The grammar readers (leg.c and peg.c built with PEG_LIBRARY). */
+
+struct _yycontext;
+
+extern FILE		 *input;
+extern struct _yycontext *yyctx;
+extern int		  yyparse(void);
+extern struct _yycontext *yyrelease(struct _yycontext *yyctx);
+
+extern FILE		 *pegInput;
+extern struct _yycontext *pegContext;
+extern int		  pegParse(void);
+extern struct _yycontext *pegRelease(struct _yycontext *yyctx);
+
+typedef struct Term Term;
+
+struct Term {
+    unsigned char  bits[32];	/* Class: the set of characters matched */
+    char	  *string;	/* String: the characters matched, unescaped */
+    int		   length;
+    int		   caseless;	/* String: ASCII letters match in either case */
+};
+
+struct Grammar {
+    Node   *rules;
+    Node   *start;
+    int	    firstNode;
+    int	    nodeCount;
+    Term   *terms;		/* one per node, indexed by node_id - firstNode */
+    char   *text;		/* the source, from which native code is made */
+    int	    length;
+    int	    syntax;
+    Native *native;
+};
+
+static inline int oigit(int c)	{ return '0' <= c && c <= '7'; }
+
+static int cnext(unsigned char **ccp)
+{
+    unsigned char *cclass= *ccp;
+    int c= *cclass++;
+    if (c)
+    {
+        if ('\\' == c && *cclass)
+        {
+            switch (c= *cclass++)
+            {
+                case 'a':  c= '\a';   break;	/* bel */
+                case 'b':  c= '\b';   break;	/* bs */
+                case 'e':  c= '\033'; break;	/* esc */
+                case 'f':  c= '\f';   break;	/* ff */
+                case 'n':  c= '\n';   break;	/* nl */
+                case 'r':  c= '\r';   break;	/* cr */
+                case 't':  c= '\t';   break;	/* ht */
+                case 'v':  c= '\v';   break;	/* vt */
+                default:
+                           if (oigit(c))
+                           {
+                               c -= '0';
+                               if (oigit(*cclass)) c= (c << 3) + *cclass++ - '0';
+                               if (oigit(*cclass)) c= (c << 3) + *cclass++ - '0';
+                           }
+                           break;
+            }
+        }
+        *ccp= cclass;
+    }
+    return c;
+}
+
+static void makeBits(unsigned char bits[32], unsigned char *cclass)
+{
+    int c, prev= -1, set= 1;
+
+    if ('^' == *cclass)
+    {
+        set= 0;
+        ++cclass;
+    }
+    memset(bits, set ? 0 : 255, 32);
+    while (*cclass)
+    {
+        if ('-' == *cclass && cclass[1] && prev >= 0)
+        {
+            ++cclass;
+            for (c= cnext(&cclass);  prev <= c;  ++prev)
+                if (set) bits[prev >> 3] |= 1 << (prev & 7);
+                else     bits[prev >> 3] &= ~(1 << (prev & 7));
+            prev= -1;
+        }
+        else
+        {
+            c= prev= cnext(&cclass);
+            if (set) bits[c >> 3] |= 1 << (c & 7);
+            else     bits[c >> 3] &= ~(1 << (c & 7));
+        }
+    }
+}
+
+static void Node_walk(Grammar *grammar, Node *node, void (*visit)(Grammar *grammar, Node *node))
+{
+    for (;  node;  node= node->any.next)
+    {
+        visit(grammar, node);
+        switch (node->type)
+        {
+            case Error:		Node_walk(grammar, node->error.element, visit);		break;
+            case Alternate:	Node_walk(grammar, node->alternate.first, visit);	break;
+            case Sequence:	Node_walk(grammar, node->sequence.first, visit);	break;
+            case PeekFor:
+            case PeekNot:
+            case Query:
+            case Star:
+            case Plus:		Node_walk(grammar, node->query.element, visit);		break;
+            default:									break;
+        }
+    }
+}
+
+static void Grammar_walk(Grammar *grammar, void (*visit)(Grammar *grammar, Node *node))
+{
+    Node *rule;
+    for (rule= grammar->rules;  rule;  rule= rule->rule.next)
+    {
+        visit(grammar, rule);
+        Node_walk(grammar, rule->rule.expression, visit);
+    }
+}
+
+static void measure(Grammar *grammar, Node *node)
+{
+    if (node->node_id < grammar->firstNode) grammar->firstNode= node->node_id;
+    if (node->node_id >= grammar->nodeCount) grammar->nodeCount= node->node_id + 1;
+}
+
+static void prepare(Grammar *grammar, Node *node)
+{
+    Term *term= &grammar->terms[node->node_id - grammar->firstNode];
+    switch (node->type)
+    {
+        case Class:
+            makeBits(term->bits, node->cclass.value);
+            break;
+
+        case Character:
+        case String:
+            {
+                unsigned char *value= (unsigned char *)node->string.value;
+                term->string= malloc(strlen(node->string.value) + 1);
+                while (*value)
+                    term->string[term->length++]= cnext(&value);
+                term->caseless= String == node->type && (StringCaseless & node->string.flags);
+            }
+            break;
+    }
+}
+
+/* Read a grammar into the global rule set (see tree.c), answering
+ * whether it was read successfully.
+ */
+int readGrammar(char *text, int length, int syntax)
+{
+    FILE *stream= fmemopen(text, length, "r");
+    int   ok;
+
+    if (!stream) return 0;
+    beginGrammar();
+    if (GrammarPeg == syntax)
+    {
+        pegInput= stream;
+        ok= pegParse();
+        pegRelease(pegContext);
+    }
+    else
+    {
+        input= stream;
+        ok= yyparse();
+        yyrelease(yyctx);
+    }
+    fclose(stream);
+    return ok && start;
+}
+
+Grammar *Grammar_parse(char *text, int length, int syntax)
+{
+    Grammar *grammar;
+
+    if (!readGrammar(text, length, syntax))
+        return 0;
+    grammar= calloc(1, sizeof(Grammar));
+    grammar->rules= rules;
+    grammar->start= start;
+    grammar->firstNode= rules->node_id;
+    Grammar_walk(grammar, measure);
+    grammar->nodeCount -= grammar->firstNode;
+    grammar->terms= calloc(grammar->nodeCount, sizeof(Term));
+    Grammar_walk(grammar, prepare);
+    grammar->text= malloc(length + 1);
+    memcpy(grammar->text, text, length);
+    grammar->text[length]= '\0';
+    grammar->length= length;
+    grammar->syntax= syntax;
+    beginGrammar();
+    return grammar;
+}
+
+Grammar *Grammar_load(char *fileName)
+{
+    FILE    *stream= fopen(fileName, "r");
+    char    *dot= strrchr(fileName, '.');
+    Grammar *grammar;
+    Buffer   text;
+    char     chunk[4096];
+    int      length;
+
+    if (!stream) return 0;
+    Buffer_init(&text);
+    while ((length= fread(chunk, 1, sizeof(chunk), stream)) > 0)
+        Buffer_append(&text, chunk, length);
+    fclose(stream);
+    grammar= Grammar_parse(text.text, text.length, (dot && !strcmp(dot, ".peg")) ? GrammarPeg : GrammarLeg);
+    Buffer_release(&text);
+    return grammar;
+}
+
+/* Arrange for the grammar to be matched by native code, compiled from
+ * the grammar in the given directory (or found there, if it was
+ * compiled before).  Matching falls back to the interpreter until the
+ * compiler has finished, unless wait is set.
+ */
+int Grammar_compile(Grammar *grammar, char *directory, int wait)
+{
+    if (!grammar->native)
+        grammar->native= Native_compile(grammar->text, grammar->length, grammar->syntax, directory, wait);
+    return grammar->native != 0;
+}
+
+/* Free a list of nodes (rules, variables or expressions) and everything
+ * they contain.  Rules are reached only through this list, never
+ * through the names that call them.
+ */
+void Node_free(Node *node)
+{
+    while (node)
+    {
+        Node *next= node->any.next;
+        switch (node->type)
+        {
+            case Rule:		free(node->rule.name);  Node_free(node->rule.variables);  Node_free(node->rule.expression);	break;
+            case Variable:	free(node->variable.name);				break;
+            case Character:
+            case String:	free(node->string.value);				break;
+            case Class:		free(node->cclass.value);				break;
+            case Action:	free(node->action.text);  free(node->action.name);	break;
+            case Predicate:	free(node->predicate.text);				break;
+            case Error:		free(node->error.text);  Node_free(node->error.element);	break;
+            case Alternate:	Node_free(node->alternate.first);			break;
+            case Sequence:	Node_free(node->sequence.first);			break;
+            case PeekFor:
+            case PeekNot:
+            case Query:
+            case Star:
+            case Plus:		Node_free(node->query.element);				break;
+        }
+        free(node);
+        node= next;
+    }
+}
+
+void Grammar_release(Grammar *grammar)
+{
+    int i;
+    if (grammar->native)
+        Native_release(grammar->native);
+    Node_free(grammar->rules);
+    for (i= 0;  i < grammar->nodeCount;  ++i)
+        free(grammar->terms[i].string);
+    free(grammar->terms);
+    free(grammar->text);
+    free(grammar);
+}
+
+
+typedef struct Matcher Matcher;
+
+struct Matcher {
+    Grammar *grammar;
+    char    *text;
+    int	     length;
+    int	     pos;
+    Node    *rule;		/* the rule being matched */
+    int	     textBegin;		/* where the last '<' of that rule matched */
+    Capture *captures;
+    int	     count;
+    int	     capacity;
+};
+
+static void capture(Matcher *m, char *name, int begin, int end)
+{
+    if (m->count == m->capacity)
+    {
+        m->capacity= m->capacity ? m->capacity * 2 : 16;
+        m->captures= realloc(m->captures, sizeof(Capture) * m->capacity);
+    }
+    m->captures[m->count].name= name;
+    m->captures[m->count].begin= begin;
+    m->captures[m->count].end= end;
+    ++m->count;
+}
+
+static void nativeCapture(void *m, char *name, int begin, int end)
+{
+    capture(m, name, begin, end);
+}
+
+/* Answer whether the n bytes at a and b differ only in the case of
+ * ASCII letters.
+ */
+static int sameFolded(char *a, char *b, int n)
+{
+    int i;
+    for (i= 0;  i < n;  ++i)
+        if (a[i] != b[i] && !(isalpha((unsigned char)a[i]) && (a[i] ^ 0x20) == b[i]))
+            return 0;
+    return 1;
+}
+
+/* Answer whether node matches at m->pos, advancing m->pos past the
+ * text matched.  On failure m->pos and the captures are left for the
+ * caller to restore.
+ */
+static int match(Matcher *m, Node *node)
+{
+    switch (node->type)
+    {
+        case Dot:
+            if (m->pos >= m->length) return 0;
+            ++m->pos;
+            return 1;
+
+        case Name:
+            {
+                Node *rule= node->name.rule, *outer= m->rule;
+                int   begin= m->pos, textBegin= m->textBegin, ok;
+                if (!rule->rule.expression) return 0;
+                m->rule= rule;
+                m->textBegin= m->pos;
+                ok= match(m, rule->rule.expression);
+                m->rule= outer;
+                m->textBegin= textBegin;
+                if (ok && node->name.variable)
+                    capture(m, node->name.variable->variable.name, begin, m->pos);
+                return ok;
+            }
+
+        case Character:
+        case String:
+            {
+                Term *term= &m->grammar->terms[node->node_id - m->grammar->firstNode];
+                if (m->length - m->pos < term->length)
+                    return 0;
+                if (term->caseless ? !sameFolded(m->text + m->pos, term->string, term->length) : memcmp(m->text + m->pos, term->string, term->length))
+                    return 0;
+                m->pos += term->length;
+                return 1;
+            }
+
+        case Class:
+            {
+                Term *term= &m->grammar->terms[node->node_id - m->grammar->firstNode];
+                int   c;
+                if (m->pos >= m->length) return 0;
+                c= (unsigned char)m->text[m->pos];
+                if (!(term->bits[c >> 3] & (1 << (c & 7)))) return 0;
+                ++m->pos;
+                return 1;
+            }
+
+        case Action:
+            return 1;
+
+        case Predicate:
+            if (!strcmp(node->predicate.text, "YY_BEGIN"))
+                m->textBegin= m->pos;
+            else if (!strcmp(node->predicate.text, "YY_END"))
+                capture(m, m->rule->rule.name, m->textBegin, m->pos);
+            return 1;
+
+        case Error:
+            return match(m, node->error.element);
+
+        case Alternate:
+            {
+                int pos= m->pos, count= m->count;
+                for (node= node->alternate.first;  node;  node= node->alternate.next)
+                {
+                    if (match(m, node)) return 1;
+                    m->pos= pos;
+                    m->count= count;
+                }
+                return 0;
+            }
+
+        case Sequence:
+            for (node= node->sequence.first;  node;  node= node->sequence.next)
+                if (!match(m, node)) return 0;
+            return 1;
+
+        case PeekFor:
+        case PeekNot:
+            {
+                int pos= m->pos, count= m->count;
+                int ok= match(m, node->peekFor.element);
+                m->pos= pos;
+                m->count= count;
+                return (PeekFor == node->type) ? ok : !ok;
+            }
+
+        case Query:
+            {
+                int pos= m->pos, count= m->count;
+                if (!match(m, node->query.element))
+                {
+                    m->pos= pos;
+                    m->count= count;
+                }
+                return 1;
+            }
+
+        case Plus:
+            if (!match(m, node->plus.element)) return 0;
+            /* fall through */
+        case Star:
+            for (;;)
+            {
+                int pos= m->pos, count= m->count;
+                if (!match(m, node->star.element) || m->pos == pos)
+                {
+                    m->pos= pos;
+                    m->count= count;
+                    return 1;
+                }
+            }
+
+        default:
+            fprintf(stderr, "\nmatch: illegal node type %d\n", node->type);
+            exit(1);
+    }
+    return 0;
+}
+
+/* Match the named rule (or the start rule if rule is null) against the
+ * beginning of text.  If it succeeds, fill in result (which should be
+ * released with Match_release()) and answer 1.
+ */
+int Grammar_match(Grammar *grammar, char *rule, char *text, int length, Match *result)
+{
+    Matcher	 m;
+    Node	 name, *start= grammar->start;
+    NativeMatch	 native;
+
+    if (rule)
+    {
+        for (start= grammar->rules;  start;  start= start->rule.next)
+        {
+            char *p= start->rule.name, *q= rule;
+            while (*p && (*p == *q || ('_' == *p && '-' == *q))) ++p, ++q;
+            if (!*p && !*q) break;
+        }
+        if (!start) return 0;
+    }
+    memset(&m, 0, sizeof(m));
+    if (grammar->native && (native= Native_function(grammar->native)))
+    {
+        if (!native(start->rule.name, text, length, &m.pos, nativeCapture, &m))
+        {
+            free(m.captures);
+            return 0;
+        }
+        result->begin= 0;
+        result->end= m.pos;
+        result->count= m.count;
+        result->captures= m.captures;
+        return 1;
+    }
+    m.grammar= grammar;
+    m.text= text;
+    m.length= length;
+    m.rule= start;
+    memset(&name, 0, sizeof(name));
+    name.type= Name;
+    name.name.rule= start;
+    if (!match(&m, &name))
+    {
+        free(m.captures);
+        return 0;
+    }
+    result->begin= 0;
+    result->end= m.pos;
+    result->count= m.count;
+    result->captures= m.captures;
+    return 1;
+}
+
+void Match_release(Match *match)
+{
+    free(match->captures);
+    match->captures= 0;
+    match->count= 0;
+}
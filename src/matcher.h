@@ -0,0 +1,53 @@
+/* Runtime grammar interpreter.
+ *
+ * Grammars written for peg or leg are read at runtime and matched
+ * directly against text, without generating and compiling a parser.
+ * Semantic actions are ignored and semantic predicates always succeed;
+ * what a match produces is its extent and a list of captures:
+ *
+ *	name:rule	captures the text matched by rule under 'name'
+ *	< ... >		captures the text between the brackets under the
+ *			name of the enclosing rule
+ *
+ * Grammar_compile() generates a C parser for the grammar, compiles it
+ * into a shared object with the system compiler ($CC, or cc) and loads
+ * it; from then on the grammar is matched by native code, with the same
+ * results.  Shared objects are kept in the given directory, named by a
+ * hash of the grammar, so that each grammar is compiled only once.  It
+ * answers 0, leaving the grammar to the interpreter, if the directory
+ * is null.  Until the native code is loaded, matching is interpreted.
+ *
+ * Reading (and compiling) grammars is not reentrant.  Matching is: any
+ * number of threads may match against the same grammar at once.
+ */
+
+#ifndef MATCHER_H
+#define MATCHER_H
+
+enum { GrammarLeg= 0, GrammarPeg };
+
+typedef struct Grammar Grammar;
+typedef struct Capture Capture;
+typedef struct Match   Match;
+
+struct Capture {
+  char *name;
+  int	begin;
+  int	end;
+};
+
+struct Match {
+  int	   begin;
+  int	   end;
+  int	   count;
+  Capture *captures;
+};
+
+extern Grammar *Grammar_load(char *fileName);
+extern Grammar *Grammar_parse(char *text, int length, int syntax);
+extern int	Grammar_compile(Grammar *grammar, char *directory, int wait);
+extern void	Grammar_release(Grammar *grammar);
+extern int	Grammar_match(Grammar *grammar, char *rule, char *text, int length, Match *result);
+extern void	Match_release(Match *match);
+
+#endif /* MATCHER_H */
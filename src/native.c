@@ -0,0 +1,324 @@
+/* Copyright (c) 2007, 2012 by Ian Piumarta
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the 'Software'),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, provided that the above copyright notice(s) and this
+ * permission notice appear in all copies of the Software.  Acknowledgement
+ * of the use of this Software in supporting documentation would be
+ * appreciated but is not required.
+ *
+ * THE SOFTWARE IS PROVIDED 'AS IS'.  USE ENTIRELY AT YOUR OWN RISK.
+ */
+
+/* Native code for runtime grammars (see Grammar_compile() in matcher.c).
+ *
+ * The grammar is read again and rewritten so that the parser generated
+ * from it computes exactly what the interpreter does: actions and
+ * semantic predicates are dropped, and each capture becomes a pair of
+ * thunks that record where it starts and ends.  Since thunks are
+ * discarded when the parser backtracks, only the captures taking part
+ * in the final match are reported.  The rewritten grammar goes through
+ * Rule_compile_c() as usual, together with an entry point yymatch().
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dlfcn.h>
+#include <pthread.h>
+
+#include "version.h"
+#include "tree.h"
+
+struct Native {
+    char	   *source;	/* generated parser */
+    char	   *object;	/* compiled parser, named by a hash of the grammar */
+    void	   *handle;
+    NativeMatch	    function;	/* yymatch() in object, once loaded */
+    int		    compiling;
+    pthread_t	    thread;
+    pthread_mutex_t lock;
+};
+
+static Buffer captures;		/* the functions run by capture thunks */
+static Buffer prototypes;
+static int    captureCount;
+
+static char *openCapture= "(yyDo(yy, yyCaptureOpen, yy->__pos, 0), 1)";
+
+/* Answer the text of a predicate that ends a capture called name. */
+static char *closeCapture(char *name)
+{
+    static char text[64];
+    ++captureCount;
+    Buffer_printf(&prototypes, "static void yycapture%d(struct _yycontext *yy, int begin, int end);\n", captureCount);
+    Buffer_printf(&captures, "static void yycapture%d(yycontext *yy, int begin, int end)\t{ yyCaptureClose(yy, \"%s\", end); }\n", captureCount, name);
+    sprintf(text, "(yyDo(yy, yycapture%d, 0, yy->__pos), 1)", captureCount);
+    return text;
+}
+
+static void setText(Node *node, char *text)
+{
+    free(node->predicate.text);
+    node->predicate.text= strdup(text);
+}
+
+static void Node_native(Node *node, Node *rule)
+{
+    for (;  node;  node= node->any.next)
+        switch (node->type)
+        {
+            case Name:
+                if (node->name.variable)
+                {
+                    Node *name= makeName(node->name.rule);
+                    Node *open= makePredicate(openCapture);
+                    Node *close= makePredicate(closeCapture(node->name.variable->variable.name));
+                    open->any.next= name;
+                    name->any.next= close;
+                    node->type= Sequence;
+                    node->sequence.first= open;
+                    node->sequence.last= close;
+                }
+                break;
+
+            case Action:
+                free(node->action.name);
+                node->type= Predicate;
+                setText(node, "1");
+                break;
+
+            case Predicate:
+                if (!strcmp(node->predicate.text, "YY_BEGIN"))
+                    setText(node, openCapture);
+                else if (!strcmp(node->predicate.text, "YY_END"))
+                    setText(node, closeCapture(rule->rule.name));
+                else
+                    setText(node, "1");
+                break;
+
+            case Error:
+                {
+                    Node *element= node->error.element;
+                    free(node->error.text);
+                    node->type= Sequence;
+                    node->sequence.first= node->sequence.last= element;
+                    Node_native(element, rule);
+                }
+                break;
+
+            case Alternate:	Node_native(node->alternate.first, rule);	break;
+            case Sequence:	Node_native(node->sequence.first, rule);	break;
+            case PeekFor:
+            case PeekNot:
+            case Query:
+            case Star:
+            case Plus:		Node_native(node->query.element, rule);	break;
+        }
+}
+
+static char *prologue= "\
+#define YY_CTX_LOCAL\n\
+#define YY_CTX_MEMBERS								\\\n\
+    char  *yyinput;  int yylength, yyoffset;					\\\n\
+    int   *yyopen;   int yyopens, yyopenslen;					\\\n\
+    void (*yycapture)(void *data, char *name, int begin, int end);		\\\n\
+    void  *yydata;\n\
+#define YY_INPUT(yy, buf, result, max)			\\\n\
+{							\\\n\
+    int yyavail= yy->yylength - yy->yyoffset;		\\\n\
+    if (yyavail > (max)) yyavail= (max);		\\\n\
+    memcpy((buf), yy->yyinput + yy->yyoffset, yyavail);	\\\n\
+    yy->yyoffset += yyavail;				\\\n\
+    result= yyavail;					\\\n\
+}\n\
+#define YY_PARSE(T)	static T\n\
+\n\
+struct _yycontext;\n\
+static void yyCaptureOpen(struct _yycontext *yy, int begin, int end);\n\
+";
+
+static char *epilogue= "\
+static void yyCaptureOpen(yycontext *yy, int begin, int end)\n\
+{\n\
+    if (yy->yyopens == yy->yyopenslen)\n\
+    {\n\
+        yy->yyopenslen= yy->yyopenslen ? yy->yyopenslen * 2 : 16;\n\
+        yy->yyopen= (int *)realloc(yy->yyopen, sizeof(int) * yy->yyopenslen);\n\
+    }\n\
+    yy->yyopen[yy->yyopens++]= begin;\n\
+}\n\
+\n\
+static void yyCaptureClose(yycontext *yy, char *name, int end)\n\
+{\n\
+    int begin= yy->yyopens ? yy->yyopen[--yy->yyopens] : end;\n\
+    yy->yycapture(yy->yydata, name, begin, end);\n\
+}\n\
+\n\
+";
+
+static char *entry= "\
+\n\
+int yymatch(char *rule, char *text, int length, int *end, void (*capture)(void *data, char *name, int begin, int end), void *data)\n\
+{\n\
+    yycontext yy;\n\
+    int       i, ok;\n\
+    for (i= 0;  yyentries[i].name && strcmp(yyentries[i].name, rule);  ++i);\n\
+    if (!yyentries[i].name) return 0;\n\
+    memset(&yy, 0, sizeof(yy));\n\
+    yy.yyinput= text;\n\
+    yy.yylength= length;\n\
+    yy.yycapture= capture;\n\
+    yy.yydata= data;\n\
+    ok= yyparsefrom(&yy, yyentries[i].rule);\n\
+    *end= yy.yyoffset - yy.__limit;\n\
+    yyrelease(&yy);\n\
+    free(yy.yyopen);\n\
+    return ok;\n\
+}\n\
+";
+
+static int writeSource(char *name, char *text, int length, int syntax)
+{
+    FILE *saved= output;
+    Node *n;
+
+    if (!readGrammar(text, length, syntax))
+        return 0;
+    Buffer_init(&captures);
+    Buffer_init(&prototypes);
+    captureCount= 0;
+    for (n= rules;  n;  n= n->rule.next)
+    {
+        Node_native(n->rule.expression, n);
+        Node_free(n->rule.variables);
+        n->rule.variables= 0;
+    }
+    actions= 0;
+
+    if ((output= fopen(name, "w")))
+    {
+        Rule_compile_c_header();
+        fprintf(output, "%s%s\n", prologue, prototypes.text);
+        Rule_compile_c(rules);
+        fprintf(output, "\n%s%s\n", epilogue, captures.text);
+        fprintf(output, "static struct { char *name;  yyrule rule; } yyentries[]= {\n");
+        for (n= rules;  n;  n= n->rule.next)
+            if (n->rule.expression)
+                fprintf(output, "  { \"%s\", yy_%s },\n", n->rule.name, n->rule.name);
+        fprintf(output, "  { 0, 0 }\n};\n%s", entry);
+        fclose(output);
+    }
+    output= saved;
+
+    Buffer_release(&captures);
+    Buffer_release(&prototypes);
+    Node_free(rules);
+    beginGrammar();
+    return 1;
+}
+
+static void Native_open(Native *native)
+{
+    void	*handle= dlopen(native->object, RTLD_NOW | RTLD_LOCAL);
+    NativeMatch  function= handle ? (NativeMatch)dlsym(handle, "yymatch") : 0;
+
+    if (!function)
+    {
+        if (handle) dlclose(handle);
+        return;
+    }
+    pthread_mutex_lock(&native->lock);
+    native->handle= handle;
+    native->function= function;
+    pthread_mutex_unlock(&native->lock);
+}
+
+static void *Native_build(void *arg)
+{
+    Native *native= arg;
+    char   *cc= getenv("CC");
+    Buffer  command, temporary;
+
+    Buffer_init(&command);
+    Buffer_init(&temporary);
+    Buffer_printf(&temporary, "%s.%d", native->object, (int)getpid());
+    Buffer_printf(&command, "%s -O2 -fPIC -shared -o '%s' '%s' >/dev/null 2>&1", cc ? cc : "cc", temporary.text, native->source);
+    if (!system(command.text) && !rename(temporary.text, native->object))
+        Native_open(native);
+    unlink(temporary.text);
+    unlink(native->source);
+    Buffer_release(&command);
+    Buffer_release(&temporary);
+    return 0;
+}
+
+/* Answer a handle on native code for the grammar in text, loading it
+ * from directory if it was built before and building it otherwise.
+ * Unless wait is set, building happens on a separate thread and
+ * Native_function() answers null until it has finished.  Answer null
+ * if there is no directory, or if its name cannot be quoted.
+ */
+Native *Native_compile(char *text, int length, int syntax, char *directory, int wait)
+{
+    unsigned long long hash= 14695981039346656037ULL;
+    Native	      *native;
+    char	       salt[64];
+    int		       i;
+
+    if (!directory || strchr(directory, '\''))
+        return 0;
+    sprintf(salt, "%d.%d.%d %d ", PEG_MAJOR, PEG_MINOR, PEG_LEVEL, syntax);
+    for (i= 0;  salt[i];  ++i)
+        hash= (hash ^ (unsigned char)salt[i]) * 1099511628211ULL;
+    for (i= 0;  i < length;  ++i)
+        hash= (hash ^ (unsigned char)text[i]) * 1099511628211ULL;
+
+    native= calloc(1, sizeof(Native));
+    pthread_mutex_init(&native->lock, 0);
+    native->object= malloc(strlen(directory) + 64);
+    native->source= malloc(strlen(directory) + 64);
+    sprintf(native->object, "%s/peg-%016llx.so", directory, hash);
+    sprintf(native->source, "%s/peg-%016llx-%d.c", directory, hash, (int)getpid());
+
+    if (!access(native->object, R_OK))
+        Native_open(native);
+    if (native->function)
+        return native;
+    if (!writeSource(native->source, text, length, syntax))
+    {
+        Native_release(native);
+        return 0;
+    }
+    if (wait || pthread_create(&native->thread, 0, Native_build, native))
+        Native_build(native);
+    else
+        native->compiling= 1;
+    return native;
+}
+
+NativeMatch Native_function(Native *native)
+{
+    NativeMatch function;
+    pthread_mutex_lock(&native->lock);
+    function= native->function;
+    pthread_mutex_unlock(&native->lock);
+    return function;
+}
+
+void Native_release(Native *native)
+{
+    if (native->compiling)
+        pthread_join(native->thread, 0);
+    if (native->handle)
+        dlclose(native->handle);
+    pthread_mutex_destroy(&native->lock);
+    free(native->object);
+    free(native->source);
+    free(native);
+}
@@ -26,6 +26,18 @@
 #include <libgen.h>
 #include <assert.h>
 
+#ifdef PEG_LIBRARY
+/* The library contains both grammar readers; keep their globals apart. */
+# define input		pegInput
+# define verboseFlag	pegVerboseFlag
+# define yyerror	pegError
+# define yyctx		pegContext
+# define _yyctx		pegContextStorage
+# define YYPARSE	pegParse
+# define YYPARSEFROM	pegParseFrom
+# define YYRELEASE	pegRelease
+#endif
+
 FILE *input= 0;
 
 int   verboseFlag= 0;
@@ -72,6 +84,8 @@ void yyerror(char *message)
     exit(1);
 }
 
+#ifndef PEG_LIBRARY
+
 static void version(char *name)
 {
     printf("%s version %d.%d.%d\n", name, PEG_MAJOR, PEG_MINOR, PEG_LEVEL);
@@ -82,8 +96,14 @@ static void usage(char *name)
     version(name);
     fprintf(stderr, "usage: %s [<option>...] [<file>...]\n", name);
     fprintf(stderr, "where <option> can be\n");
+    fprintf(stderr, "  -b          generate a compact bytecode parser\n");
+    fprintf(stderr, "  -c <cfile>  reuse code for unchanged rules cached in <cfile>\n");
     fprintf(stderr, "  -h          print this help information\n");
+    fprintf(stderr, "  -j <n>      split the output into a header, <ofile> and <n> rule files\n");
     fprintf(stderr, "  -o <ofile>  write output to <ofile>\n");
+    fprintf(stderr, "  -p <pfile>  place code using rule counts from a profile in <pfile>\n");
+    fprintf(stderr, "  -t          generate a parser that builds a parse tree\n");
+    fprintf(stderr, "  -T <n>      generate code for rules using <n> threads\n");
     fprintf(stderr, "  -v          be verbose\n");
     fprintf(stderr, "  -V          print version number and exit\n");
     fprintf(stderr, "if no <file> is given, input is read from stdin\n");
@@ -96,13 +116,15 @@ int main(int argc, char **argv)
     Node *n;
     int   c;
     int greenteaMode = 0;
+    int bytecodeMode= 0;
+    char *outputName= 0;
 
     output= stdout;
     input= stdin;
     lineNumber= 1;
     fileName= "<stdin>";
 
-    while (-1 != (c= getopt(argc, argv, "Vhgo:v")))
+    while (-1 != (c= getopt(argc, argv, "Vbc:hj:gT:o:p:tv")))
     {
         switch (c)
         {
@@ -110,6 +132,14 @@ int main(int argc, char **argv)
                 version(basename(argv[0]));
                 exit(0);
 
+            case 'b':
+                bytecodeMode= 1;
+                break;
+
+            case 'c':
+                cacheName= optarg;
+                break;
+
             case 'h':
                 usage(basename(argv[0]));
                 break;
@@ -117,14 +147,35 @@ int main(int argc, char **argv)
             case 'g':
                 greenteaMode = 1;
                 break;
-            case 'o':
-                if (!(output= fopen(optarg, "w")))
+
+            case 'j':
+                if ((splitCount= atoi(optarg)) < 1)
                 {
-                    perror(optarg);
+                    fprintf(stderr, "%s: number of rule files must be positive\n", optarg);
                     exit(1);
                 }
                 break;
 
+            case 'T':
+                if ((threadCount= atoi(optarg)) < 1)
+                {
+                    fprintf(stderr, "%s: number of threads must be positive\n", optarg);
+                    exit(1);
+                }
+                break;
+
+            case 'o':
+                outputName= optarg;
+                break;
+
+            case 'p':
+                profileName= optarg;
+                break;
+
+            case 't':
+                parseTree= 1;
+                break;
+
             case 'v':
                 verboseFlag= 1;
                 break;
@@ -134,9 +185,22 @@ int main(int argc, char **argv)
                 exit(1);
         }
     }
+    if (splitCount && (!outputName || greenteaMode || bytecodeMode))
+    {
+        fprintf(stderr, "%s: -j requires -o and cannot be used with -b or -g\n", argv[0]);
+        exit(1);
+    }
+    if (parseTree && (greenteaMode || bytecodeMode))
+    {
+        fprintf(stderr, "%s: -t cannot be used with -b or -g\n", argv[0]);
+        exit(1);
+    }
     argc -= optind;
     argv += optind;
 
+    if (outputName)
+        output= openOutput(splitCount ? Rule_compile_c_split(outputName) : outputName);
+
     if (argc)
     {
         for (;  argc;  --argc, ++argv)
@@ -176,8 +240,14 @@ int main(int argc, char **argv)
             Rule_compile_green(rules);
     } else {
         Rule_compile_c_header();
-        if (rules) Rule_compile_c(rules);
+        if (rules && bytecodeMode) Rule_compile_vm(rules);
+        else if (rules) Rule_compile_c(rules);
     }
 
+    if (output != stdout)
+        closeOutput(output);
+
     return 0;
 }
+
+#endif /* PEG_LIBRARY */
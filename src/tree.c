@@ -19,11 +19,14 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdarg.h>
 #include <assert.h>
 
 #ifdef WIN32
 # undef inline
 # define inline __inline
+#else
+# include <pthread.h>
 #endif
 
 #include "tree.h"
@@ -35,6 +38,8 @@ Node *start= 0;
 
 FILE *output= 0;
 
+int threadCount= 1;
+
 int actionCount= 0;
 int ruleCount= 0;
 int lastToken= -1;
@@ -94,6 +99,13 @@ void Rule_setExpression(Node *node, Node *expression)
         start= node;
 }
 
+Node *Rule_beToken(Node *rule)
+{
+    assert(Rule == rule->type);
+    rule->rule.flags |= RuleToken;
+    return rule;
+}
+
 Node *makeVariable(char *name)
 {
     Node *node;
@@ -132,13 +144,22 @@ Node *makeCharacter(char *text)
 Node *makeString(char *text)
 {
     Node *node= newNode(String);
-    node->string.value= strdup(text);
+    node->string.value= String_unicode(text);
     return node;
 }
 
+Node *String_beCaseless(Node *string)
+{
+    assert(String == string->type);
+    string->string.flags |= StringCaseless;
+    return string;
+}
+
 Node *makeClass(char *text)
 {
-    Node *node= newNode(Class);
+    Node *node= Class_unicode(text);
+    if (node) return node;
+    node= newNode(Class);
     node->cclass.value= (unsigned char *)strdup(text);
     return node;
 }
@@ -150,6 +171,11 @@ Node *makeAction(char *text)
     assert(thisRule);
     sprintf(name, "_%d_%s", ++actionCount, thisRule->rule.name);
     node->action.name= strdup(name);
+    if ('!' == *text)
+    {
+        node->action.flags |= ActionForced;
+        ++text;
+    }
     node->action.text= strdup(text);
     node->action.list= actions;
     node->action.rule= thisRule;
@@ -264,6 +290,117 @@ Node *makePlus(Node *e)
 }
 
 
+void Buffer_init(Buffer *buf)
+{
+    buf->capacity= 1024;
+    buf->length= 0;
+    buf->text= malloc(buf->capacity);
+    buf->text[0]= '\0';
+}
+
+static void Buffer_reserve(Buffer *buf, int length)
+{
+    if (buf->length + length < buf->capacity) return;
+    while (buf->length + length >= buf->capacity)
+        buf->capacity *= 2;
+    buf->text= realloc(buf->text, buf->capacity);
+}
+
+void Buffer_append(Buffer *buf, const char *text, int length)
+{
+    Buffer_reserve(buf, length);
+    memcpy(buf->text + buf->length, text, length);
+    buf->length += length;
+    buf->text[buf->length]= '\0';
+}
+
+void Buffer_printf(Buffer *buf, const char *fmt, ...)
+{
+    va_list ap;
+    int     length;
+    va_start(ap, fmt);
+    length= vsnprintf(buf->text + buf->length, buf->capacity - buf->length, fmt, ap);
+    va_end(ap);
+    if (length >= buf->capacity - buf->length)
+    {
+        Buffer_reserve(buf, length);
+        va_start(ap, fmt);
+        vsnprintf(buf->text + buf->length, buf->capacity - buf->length, fmt, ap);
+        va_end(ap);
+    }
+    buf->length += length;
+}
+
+void Buffer_release(Buffer *buf)
+{
+    free(buf->text);
+    buf->text= 0;
+    buf->length= buf->capacity= 0;
+}
+
+
+#ifndef WIN32
+
+typedef struct {
+    void	  (*work)(void *data, int index);
+    void	   *data;
+    int		    count;
+    int		    next;
+    pthread_mutex_t lock;
+} Parallel;
+
+static void *Parallel_run(void *arg)
+{
+    Parallel *p= arg;
+    for (;;)
+    {
+        int index;
+        pthread_mutex_lock(&p->lock);
+        index= p->next < p->count ? p->next++ : -1;
+        pthread_mutex_unlock(&p->lock);
+        if (index < 0) break;
+        p->work(p->data, index);
+    }
+    return 0;
+}
+
+#endif
+
+/* Call work(data, i) for each i in [0, count), using up to threadCount
+ * threads.  Calls may happen in any order and concurrently, so work()
+ * must only write to state owned by its index.
+ */
+void runParallel(int count, void (*work)(void *data, int index), void *data)
+{
+    int i;
+#ifndef WIN32
+    if (threadCount > 1 && count > 1)
+    {
+        int        n= threadCount < count ? threadCount : count;
+        pthread_t *threads= malloc(sizeof(pthread_t) * n);
+        Parallel   p;
+        p.work=  work;
+        p.data=  data;
+        p.count= count;
+        p.next=  0;
+        pthread_mutex_init(&p.lock, 0);
+        for (i= 1;  i < n;  ++i)
+            if (pthread_create(&threads[i], 0, Parallel_run, &p))
+                break;
+        n= i;
+        Parallel_run(&p);
+        for (i= 1;  i < n;  ++i)
+            pthread_join(threads[i], 0);
+        pthread_mutex_destroy(&p.lock);
+        free(threads);
+        return;
+    }
+#endif
+    for (i= 0;  i < count;  ++i)
+        work(data, i);
+}
+
+
 static Node  *stack[1024];
 static Node **stackPointer= stack;
 
@@ -306,6 +443,16 @@ Node *pop(void)
     return *stackPointer--;
 }
 
+/* Forget the rules read so far (without freeing them) so that another
+ * grammar can be read into an empty rule set.
+ */
+void beginGrammar(void)
+{
+    actions= rules= thisRule= start= 0;
+    ruleCount= actionCount= 0;
+    stackPointer= stack;
+}
+
 
 static void Node_fprint(FILE *stream, Node *node)
 {
@@ -316,9 +463,9 @@ static void Node_fprint(FILE *stream, Node *node)
         case Name:		fprintf(stream, " %s", node->name.rule->rule.name);			break;
         case Dot:		fprintf(stream, " .");							break;
         case Character:	fprintf(stream, " '%s'", node->character.value);			break;
-        case String:	fprintf(stream, " \"%s\"", node->string.value);				break;
+        case String:	fprintf(stream, " \"%s\"%s", node->string.value, (StringCaseless & node->string.flags) ? "i" : "");	break;
         case Class:		fprintf(stream, " [%s]", node->cclass.value);				break;
-        case Action:	fprintf(stream, " { %s }", node->action.text);				break;
+        case Action:	fprintf(stream, " {%s %s }", (ActionForced & node->action.flags) ? "!" : "", node->action.text);				break;
         case Predicate:	fprintf(stream, " ?{ %s }", node->action.text);				break;
 
         case Alternate:	node= node->alternate.first;
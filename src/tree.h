@@ -23,6 +23,30 @@ enum { Unknown= 0, Rule, Variable, Name, Dot, Character, String, Class, Action,
 enum {
   RuleUsed    = 1<<0,
   RuleReached = 1<<1,
+  RuleToken   = 1<<2,	/* compiled as a scanner (see Rule_compile_c) */
+  RuleCommitted = 1<<3,	/* no caller can backtrack over a successful call */
+  RuleMemo    = 1<<4,	/* results can be memoized (see Rule_findMemo) */
+};
+
+enum {
+  ActionForced = 1<<0,	/* written { ! ... }: always run eagerly */
+  ActionEager  = 1<<1,	/* run when reached instead of being deferred */
+};
+
+enum {
+  StringCaseless = 1<<0,	/* written "..."i: matches ASCII letters in either case */
+};
+
+/* Parts of the parser state that a subexpression may change, and that
+ * a backtrack point around it must therefore save and restore.
+ */
+enum {
+  EffectPos	= 1<<0,		/* __pos */
+  EffectThunks	= 1<<1,		/* __thunkpos */
+  EffectBegin	= 1<<2,		/* __begin */
+  EffectEnd	= 1<<3,		/* __end */
+  EffectAll	= (1<<4) - 1,
+  EffectNodes	= 1<<4,		/* __nodecount, changed only by the parser itself */
 };
 
 typedef union Node Node;
@@ -35,6 +59,7 @@ struct Rule  {
   Node *expression;
   int id;
   int flags;
+  int effects;
 };
 struct Variable {
   int type; int node_id;
@@ -48,6 +73,7 @@ struct Name {
   Node *next;
   Node *rule;
   Node *variable;
+  Node *setter;		/* action that sets variable, if not a thunk of its own */
 };
 struct Dot {
   int type; int node_id;
@@ -62,6 +88,7 @@ struct String {
   int type; int node_id;
   Node *next;
   char *value;
+  int flags;
 };
 struct Class {
   int type; int node_id;
@@ -75,6 +102,8 @@ struct Action {
   Node *list;
   char *name;
   Node *rule;
+  Node *binding;	/* variable that the action sets to $$ before running */
+  int flags;
 };
 struct Predicate {
   int type; int node_id;
@@ -159,6 +188,7 @@ extern Node *rules;
 extern Node *start;
 
 extern int   ruleCount;
+extern int   threadCount;
 
 extern FILE *output;
 
@@ -172,6 +202,7 @@ extern Node *makeName(Node *rule);
 extern Node *makeDot(void);
 extern Node *makeCharacter(char *text);
 extern Node *makeString(char *text);
+extern Node *String_beCaseless(Node *string);
 extern Node *makeClass(char *text);
 extern Node *makeAction(char *text);
 extern Node *makePredicate(char *text);
@@ -188,12 +219,68 @@ extern Node *makePlus(Node *e);
 extern Node *push(Node *node);
 extern Node *top(void);
 extern Node *pop(void);
+extern void  beginGrammar(void);
+
+typedef struct Buffer Buffer;
+
+struct Buffer {
+  char *text;
+  int   length;
+  int   capacity;
+};
+
+extern void  Buffer_init(Buffer *buf);
+extern void  Buffer_append(Buffer *buf, const char *text, int length);
+extern void  Buffer_printf(Buffer *buf, const char *fmt, ...);
+extern void  Buffer_release(Buffer *buf);
+
+extern int   splitCount;
+extern int   parseTree;
+extern char *profileName;
 
 extern void  Rule_compile_c_header(void);
+extern char *Rule_compile_c_split(char *name);
 extern void  Rule_compile_c(Node *node);
+extern void  Rule_compile_c_preamble(void);
+extern void  Rule_compile_c_footer(void);
+extern void  Action_compile_c(Node *node);
+extern int   consumesInput(Node *node);
+extern int   Node_firstSet(Node *node, unsigned char bits[32], char *visiting);
+extern void  Class_compile_c(Buffer *buf, unsigned char *cclass);
+extern void  Class_bits(unsigned char bits[32], unsigned char *cclass);
+extern int   Char_next(unsigned char **ccp);
+extern int   String_fold(Buffer *lower, Buffer *mask, int *length, char *text);
+
+extern int   Rule_compile_dfa(Buffer *buf, Node *rule);
+
+extern Node *Class_unicode(char *text);
+extern char *String_unicode(char *text);
+
+extern void  Rule_compile_vm(Node *node);
 
 extern void  Rule_compile_green_header(void);
 extern void  Rule_compile_green(Node *node);
 
+extern void  runParallel(int count, void (*work)(void *data, int index), void *data);
+
+extern char *cacheName;
+
+extern void  Cache_begin(char *salt);
+extern char *Cache_find(Node *rule);
+extern void  Cache_add(Node *rule, char *text);
+extern void  Cache_end(void);
+
+typedef struct Native Native;
+typedef int (*NativeMatch)(char *rule, char *text, int length, int *end, void (*capture)(void *data, char *name, int begin, int end), void *data);
+
+extern int	   readGrammar(char *text, int length, int syntax);
+extern void	   Node_free(Node *node);
+extern Native	  *Native_compile(char *text, int length, int syntax, char *directory, int wait);
+extern NativeMatch Native_function(Native *native);
+extern void	   Native_release(Native *native);
+
+extern FILE *openOutput(char *name);
+extern void  closeOutput(FILE *stream);
+
 extern void  Node_print(Node *node);
 extern void  Rule_print(Node *node);